@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui svg
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,15 +9,51 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    allocationcounter.cpp \
+    animation.cpp \
+    benchmark.cpp \
+    bvh.cpp \
+    deformation.cpp \
+    exporter.cpp \
+    framearena.cpp \
     main.cpp \
     mainwindow.cpp \
     matrix.cpp \
-    plotarea.cpp
+    mesh.cpp \
+    parallel.cpp \
+    plotarea.cpp \
+    pointsplatter.cpp \
+    projection.cpp \
+    regression.cpp \
+    renderer.cpp \
+    scenefile.cpp \
+    stream.cpp \
+    trace.cpp \
+    turntable.cpp
 
 HEADERS += \
+    allocationcounter.h \
+    animation.h \
+    benchmark.h \
+    boundedqueue.h \
+    bvh.h \
+    deformation.h \
+    exporter.h \
+    framearena.h \
     mainwindow.h \
     matrix.h \
-    plotarea.h
+    mesh.h \
+    parallel.h \
+    plotarea.h \
+    pointsplatter.h \
+    projection.h \
+    regression.h \
+    renderer.h \
+    scenefile.h \
+    stream.h \
+    trace.h \
+    triplebuffer.h \
+    turntable.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,201 @@
+#include "allocationcounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<quint64> allocations[AllocationCounter::subsystemCount];
+std::atomic<quint64> bytes[AllocationCounter::subsystemCount];
+thread_local AllocationCounter::Subsystem current = AllocationCounter::Subsystem::Other;
+
+void count(std::size_t size)
+{
+    int subsystem = static_cast<int>(current);
+    allocations[subsystem].fetch_add(1, std::memory_order_relaxed);
+    bytes[subsystem].fetch_add(size, std::memory_order_relaxed);
+}
+
+void* allocate(std::size_t size)
+{
+    count(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    count(size);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    size = (size + align - 1) / align * align;
+#ifdef Q_OS_WIN
+    return _aligned_malloc(size ? size : align, align);
+#else
+    return std::aligned_alloc(align, size ? size : align);
+#endif
+}
+
+void freeAligned(void* pointer)
+{
+#ifdef Q_OS_WIN
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+}
+
+quint64 AllocationCounter::Counts::GetAllocations() const
+{
+    quint64 total = 0;
+    for (quint64 value : allocations)
+    {
+        total += value;
+    }
+    return total;
+}
+
+quint64 AllocationCounter::Counts::GetBytes() const
+{
+    quint64 total = 0;
+    for (quint64 value : bytes)
+    {
+        total += value;
+    }
+    return total;
+}
+
+AllocationCounter::Counts AllocationCounter::Counts::operator-(Counts const& other) const
+{
+    Counts res;
+    for (int i = 0; i < subsystemCount; ++i)
+    {
+        res.allocations[i] = allocations[i] - other.allocations[i];
+        res.bytes[i] = bytes[i] - other.bytes[i];
+    }
+    return res;
+}
+
+AllocationCounter::Scope::Scope(Subsystem subsystem):
+    previous(current)
+{
+    current = subsystem;
+}
+
+AllocationCounter::Scope::~Scope()
+{
+    current = previous;
+}
+
+quint64 AllocationCounter::GetAllocations()
+{
+    return GetCounts().GetAllocations();
+}
+
+quint64 AllocationCounter::GetBytes()
+{
+    return GetCounts().GetBytes();
+}
+
+AllocationCounter::Counts AllocationCounter::GetCounts()
+{
+    Counts res;
+    for (int i = 0; i < subsystemCount; ++i)
+    {
+        res.allocations[i] = allocations[i].load(std::memory_order_relaxed);
+        res.bytes[i] = bytes[i].load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+const char* AllocationCounter::GetName(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case Subsystem::Matrix:
+        return "matrix";
+    case Subsystem::Geometry:
+        return "geometry";
+    case Subsystem::Painter:
+        return "painter";
+    default:
+        return "other";
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* pointer = allocate(size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = allocateAligned(size, alignment))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
@@ -0,0 +1,47 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts calls to the global operator new made by this executable. Used by
+// the benchmarks to check that a steady-state frame stays off the heap, and
+// by the status bar to show where a frame or a user action allocates.
+class AllocationCounter
+{
+public:
+    enum class Subsystem
+    {
+        Other,
+        Matrix,
+        Geometry,
+        Painter,
+        Count
+    };
+    static constexpr int subsystemCount = static_cast<int>(Subsystem::Count);
+    struct Counts
+    {
+        quint64 allocations[subsystemCount] = {};
+        quint64 bytes[subsystemCount] = {};
+        quint64 GetAllocations() const;
+        quint64 GetBytes() const;
+        Counts operator-(Counts const& other) const;
+    };
+    // Attributes allocations made by the current thread to a subsystem while
+    // alive; the innermost scope wins.
+    class Scope
+    {
+    public:
+        explicit Scope(Subsystem subsystem);
+        ~Scope();
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+    private:
+        Subsystem previous;
+    };
+    static quint64 GetAllocations();
+    static quint64 GetBytes();
+    static Counts GetCounts();
+    static const char* GetName(Subsystem subsystem);
+};
+
+#endif // ALLOCATIONCOUNTER_H
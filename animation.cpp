@@ -0,0 +1,133 @@
+#include "animation.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+Animation::Animation(QObject *parent) : QObject(parent)
+{
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &Animation::tick);
+}
+
+void Animation::AddKeyframe(Keyframe const& keyframe)
+{
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), keyframe.time,
+                               [](double time, Keyframe const& k) { return time < k.time; });
+    keyframes.insert(it, keyframe);
+}
+
+void Animation::ClearKeyframes()
+{
+    keyframes.clear();
+}
+
+void Animation::SetTargetFps(int fps)
+{
+    targetFps = std::max(1, fps);
+    timer.setInterval(1000 / targetFps);
+}
+
+void Animation::SetLooping(bool newLooping)
+{
+    looping = newLooping;
+}
+
+void Animation::Start()
+{
+    if (keyframes.empty())
+    {
+        return;
+    }
+    droppedFrames = 0;
+    statsFrames = 0;
+    achievedFps = 0;
+    lastFrame = 0;
+    statsStart = 0;
+    clock.start();
+    timer.start(1000 / targetFps);
+    tick();
+}
+
+void Animation::Stop()
+{
+    timer.stop();
+}
+
+bool Animation::IsRunning() const
+{
+    return timer.isActive();
+}
+
+double Animation::GetDuration() const
+{
+    return keyframes.empty() ? 0 : keyframes.back().time;
+}
+
+Matrix Animation::Evaluate(double time) const
+{
+    TRACE_SCOPE("transform", "Animation::Evaluate");
+    if (keyframes.empty())
+    {
+        return Matrix::GetIdentityMatrix();
+    }
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](double t, Keyframe const& k) { return t < k.time; });
+    const Keyframe& a = next == keyframes.begin() ? *next : *(next - 1);
+    const Keyframe& b = next == keyframes.end() ? keyframes.back() : *next;
+    float alpha = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0;
+    QQuaternion rotation = QQuaternion::slerp(a.rotation, b.rotation, alpha);
+    QVector3D scale = a.scale + (b.scale - a.scale) * alpha;
+    QVector3D translation = a.translation + (b.translation - a.translation) * alpha;
+    return Matrix::GetTranslationMatrix(translation.x(), translation.y(), translation.z())
+           * Matrix::GetRotationMatrix(rotation)
+           * Matrix::GetScaleMatrix(scale.x(), scale.y(), scale.z());
+}
+
+int Animation::GetTargetFps() const
+{
+    return targetFps;
+}
+
+double Animation::GetAchievedFps() const
+{
+    return achievedFps;
+}
+
+int Animation::GetDroppedFrames() const
+{
+    return droppedFrames;
+}
+
+void Animation::tick()
+{
+    qint64 now = clock.nsecsElapsed();
+    qint64 period = 1000000000 / targetFps;
+    if (lastFrame > 0 && now - lastFrame > period * 3 / 2)
+    {
+        droppedFrames += (now - lastFrame) / period - 1;
+    }
+    lastFrame = now;
+
+    double time = now / 1e9;
+    double duration = GetDuration();
+    bool finished = !looping && time >= duration;
+    if (looping && duration > 0)
+    {
+        time = std::fmod(time, duration);
+    }
+    emit FrameChanged(Evaluate(std::min(time, duration)));
+
+    ++statsFrames;
+    if (now - statsStart >= stats_interval)
+    {
+        achievedFps = statsFrames * 1e9 / (now - statsStart);
+        statsFrames = 0;
+        statsStart = now;
+        emit StatsChanged();
+    }
+    if (finished)
+    {
+        Stop();
+        emit Finished();
+    }
+}
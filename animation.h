@@ -0,0 +1,56 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QQuaternion>
+#include <QVector3D>
+#include <vector>
+#include "matrix.h"
+
+class Animation : public QObject
+{
+    Q_OBJECT
+public:
+    struct Keyframe
+    {
+        double time;
+        QQuaternion rotation;
+        QVector3D scale;
+        QVector3D translation;
+    };
+    explicit Animation(QObject *parent = nullptr);
+    void AddKeyframe(Keyframe const& keyframe);
+    void ClearKeyframes();
+    void SetTargetFps(int fps);
+    void SetLooping(bool newLooping);
+    void Start();
+    void Stop();
+    bool IsRunning() const;
+    double GetDuration() const;
+    Matrix Evaluate(double time) const;
+    int GetTargetFps() const;
+    double GetAchievedFps() const;
+    int GetDroppedFrames() const;
+signals:
+    void FrameChanged(Matrix const& transform);
+    void StatsChanged();
+    void Finished();
+private slots:
+    void tick();
+private:
+    std::vector<Keyframe> keyframes;
+    QTimer timer;
+    QElapsedTimer clock;
+    int targetFps = 60;
+    bool looping = true;
+    qint64 lastFrame = 0;
+    qint64 statsStart = 0;
+    int statsFrames = 0;
+    int droppedFrames = 0;
+    double achievedFps = 0;
+    qint64 stats_interval = 1000000000;
+};
+
+#endif // ANIMATION_H
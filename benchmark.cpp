@@ -0,0 +1,338 @@
+#include "benchmark.h"
+#include "matrix.h"
+#include "allocationcounter.h"
+#include "renderer.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <cmath>
+#include <random>
+
+namespace
+{
+struct GemmCase
+{
+    const char* name;
+    int n, m, p;
+};
+
+const GemmCase gemmCases[] = {
+    {"transform 4x4 * 4x4", 4, 4, 4},
+    {"points 4x4 * 4x100000", 4, 4, 100000},
+    {"square 64", 64, 64, 64},
+    {"square 256", 256, 256, 256},
+    {"square 512", 512, 512, 512},
+    {"tall 1024x64 * 64x1024", 1024, 64, 1024},
+};
+
+const qint64 minimumNanoseconds = 200000000;
+
+struct FrameCase
+{
+    const char* name;
+    // No rings: a star profile of segments points, extruded.
+    int rings;
+    int segments;
+    int instances;
+    bool multiView;
+    Mesh::VertexFormat format;
+    bool deformed = false;
+    // A cloud of segments points without edges, drawn as points.
+    bool points = false;
+};
+
+const FrameCase frameCases[] = {
+    {"torus 1k", 20, 50, 0, false, Mesh::VertexFormat::Float},
+    {"torus 100k", 200, 500, 0, false, Mesh::VertexFormat::Float},
+    {"torus 100k, 16-bit vertices", 200, 500, 0, false, Mesh::VertexFormat::Quantized16},
+    {"torus 1M, twisted and bent", 1000, 1000, 0, false, Mesh::VertexFormat::Float, true},
+    {"torus 1k x 16 instances", 20, 50, 16, false, Mesh::VertexFormat::Float},
+    {"torus 1k, four views", 20, 50, 0, true, Mesh::VertexFormat::Float},
+    {"extruded profile 100k", 0, 50000, 0, false, Mesh::VertexFormat::Float},
+    {"point cloud 10M", 0, 10000000, 0, false, Mesh::VertexFormat::Float, false, true},
+    {"point cloud 10M, four views", 0, 10000000, 0, true, Mesh::VertexFormat::Float, false, true},
+};
+
+const int warmupFrames = 5;
+const int measuredFrames = 50;
+
+// A noisy shell around a torus, like a scan of one.
+Mesh pointCloud(size_t count)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto vertices = std::make_shared<std::vector<PackedVertex>>(count);
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> angle(0, float(2 * M_PI));
+    std::normal_distribution<float> noise(0, 0.05f);
+    for (PackedVertex& v : *vertices)
+    {
+        float phi = angle(random);
+        float theta = angle(random);
+        float r = 4 + (1.5f + noise(random)) * std::cos(theta);
+        v = {r * std::cos(phi), 1.5f * std::sin(theta), r * std::sin(phi)};
+    }
+    return Mesh::FromBuffers(vertices->data(), Mesh::VertexFormat::Float, Mesh::Quantization(), count, nullptr, 0, vertices);
+}
+
+Mesh frameMesh(FrameCase const& c)
+{
+    if (c.points)
+    {
+        return pointCloud(c.segments);
+    }
+    if (c.rings > 0)
+    {
+        return Mesh::Torus(c.rings, c.segments, c.format);
+    }
+    std::vector<Point> profile;
+    for (int i = 0; i <= c.segments; ++i)
+    {
+        double phi = 2 * M_PI * i / c.segments;
+        double r = i % 2 == 0 ? 6 : 5;
+        profile.push_back(Point(r * cos(phi), r * sin(phi), -4));
+    }
+    return Mesh::Extrusion({profile}, Point(0, 0, 8, 0), c.format);
+}
+
+std::vector<double> randomValues(size_t count, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> distribution(-1, 1);
+    std::vector<double> values(count);
+    for (double& value : values)
+    {
+        value = distribution(random);
+    }
+    return values;
+}
+
+// Repeats body until enough time has passed for a stable figure; returns
+// nanoseconds per call.
+template <typename Body>
+double measure(Body body)
+{
+    body();
+    QElapsedTimer timer;
+    qint64 iterations = 0;
+    timer.start();
+    do
+    {
+        body();
+        ++iterations;
+    }
+    while (timer.nsecsElapsed() < minimumNanoseconds);
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+// The multiply Matrix used before blocking: separately allocated rows and a
+// column walk over B, kept here as the baseline the GFLOP/s are compared to.
+double referenceMultiply(GemmCase const& c, std::vector<double> const& a, std::vector<double> const& b)
+{
+    std::vector<std::vector<double>> ra(c.n, std::vector<double>(c.m));
+    std::vector<std::vector<double>> rb(c.m, std::vector<double>(c.p));
+    for (int i = 0; i < c.n; ++i)
+    {
+        std::copy(a.begin() + i * c.m, a.begin() + (i + 1) * c.m, ra[i].begin());
+    }
+    for (int k = 0; k < c.m; ++k)
+    {
+        std::copy(b.begin() + size_t(k) * c.p, b.begin() + size_t(k + 1) * c.p, rb[k].begin());
+    }
+    return measure([&]()
+    {
+        std::vector<std::vector<double>> rc(c.n, std::vector<double>(c.p));
+        for (int i = 0; i < c.n; ++i)
+        {
+            for (int j = 0; j < c.p; ++j)
+            {
+                for (int k = 0; k < c.m; ++k)
+                {
+                    rc[i][j] += ra[i][k] * rb[k][j];
+                }
+            }
+        }
+        volatile double sink = rc[0][0];
+        (void)sink;
+    });
+}
+}
+
+QJsonArray Benchmark::RunMatrix()
+{
+    std::mt19937 random(6);
+    QJsonArray results;
+    for (GemmCase const& c : gemmCases)
+    {
+        std::vector<double> a = randomValues(size_t(c.n) * c.m, random);
+        std::vector<double> b = randomValues(size_t(c.m) * c.p, random);
+        Matrix ma = Matrix::FromValues(c.n, c.m, a.data());
+        Matrix mb = Matrix::FromValues(c.m, c.p, b.data());
+        double blocked = measure([&]()
+        {
+            Matrix product = ma * mb;
+            volatile double sink = product.getElement(0, 0);
+            (void)sink;
+        });
+        double reference = referenceMultiply(c, a, b);
+        double flops = 2.0 * c.n * c.m * c.p;
+        QJsonObject result;
+        result["name"] = QString("gemm %1").arg(c.name);
+        result["ns"] = blocked;
+        result["gflops"] = flops / blocked;
+        result["reference_gflops"] = flops / reference;
+        results.append(result);
+        qInfo().noquote() << QString("%1: %2 GFLOP/s (было %3)")
+                             .arg(result["name"].toString())
+                             .arg(flops / blocked, 0, 'f', 2)
+                             .arg(flops / reference, 0, 'f', 2);
+    }
+    return results;
+}
+
+QJsonArray Benchmark::RunFrames()
+{
+    QJsonArray results;
+    QSize size(1000, 800);
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (FrameCase const& c : frameCases)
+    {
+        Renderer renderer;
+        renderer.SetMesh(frameMesh(c));
+        if (c.deformed)
+        {
+            Deformation deformation;
+            deformation.twist = 0.2;
+            deformation.bend = 0.05;
+            renderer.SetDeformation(deformation);
+        }
+        renderer.SetMultiView(c.multiView);
+        renderer.SetPointCloud(c.points);
+        for (int i = 0; i < c.instances; ++i)
+        {
+            renderer.AddInstance(Matrix::GetTranslationMatrix(12 * (i % 4) - 18, 0, 12 * (i / 4) - 18));
+        }
+        double angleX, angleY, angleZ;
+        renderer.GetRotation(angleX, angleY, angleZ);
+        QPainter painter(&image);
+        quint64 prepareAllocations = 0;
+        quint64 drawAllocations = 0;
+        qint64 prepareNs = 0;
+        qint64 drawNs = 0;
+        QElapsedTimer timer;
+        QElapsedTimer phase;
+        AllocationCounter::Counts measuredStart;
+        for (int frame = 0; frame < warmupFrames + measuredFrames; ++frame)
+        {
+            if (frame == warmupFrames)
+            {
+                measuredStart = AllocationCounter::GetCounts();
+                timer.start();
+            }
+            // Rotate every frame so the cached axis geometry is rebuilt too.
+            renderer.SetRotation(angleX, angleY + 0.01 * frame, angleZ);
+            image.fill(Qt::white);
+            // The two phases Render runs, timed and counted separately.
+            quint64 before = AllocationCounter::GetAllocations();
+            phase.start();
+            renderer.PrepareFrame(size);
+            qint64 prepareElapsed = phase.nsecsElapsed();
+            quint64 prepared = AllocationCounter::GetAllocations();
+            phase.start();
+            renderer.Draw(painter, size);
+            qint64 drawElapsed = phase.nsecsElapsed();
+            quint64 after = AllocationCounter::GetAllocations();
+            if (frame >= warmupFrames)
+            {
+                prepareAllocations += prepared - before;
+                drawAllocations += after - prepared;
+                prepareNs += prepareElapsed;
+                drawNs += drawElapsed;
+            }
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / measuredFrames;
+        AllocationCounter::Counts measured = AllocationCounter::GetCounts() - measuredStart;
+
+        // The same frames in the interactive tier, for comparison.
+        renderer.SetQuality(Renderer::Quality::Preview);
+        timer.start();
+        for (int frame = 0; frame < measuredFrames; ++frame)
+        {
+            renderer.SetRotation(angleX, angleY + 0.01 * frame, angleZ);
+            image.fill(Qt::white);
+            renderer.Render(painter, size);
+        }
+        double previewMs = timer.nsecsElapsed() / 1e6 / measuredFrames;
+        painter.end();
+
+        QJsonObject result;
+        result["name"] = QString("frame %1").arg(c.name);
+        result["ms"] = ms;
+        result["prepare_ms"] = prepareNs / 1e6 / measuredFrames;
+        result["draw_ms"] = drawNs / 1e6 / measuredFrames;
+        result["preview_ms"] = previewMs;
+        result["strips"] = double(renderer.GetMesh().CountStrips());
+        result["vertex_bytes"] = double(renderer.GetMesh().GetStoredVertexCount() * Mesh::GetVertexSize(c.format));
+        result["prepare_allocations_per_frame"] = double(prepareAllocations) / measuredFrames;
+        result["draw_allocations_per_frame"] = double(drawAllocations) / measuredFrames;
+        QJsonObject subsystems;
+        for (int i = 0; i < AllocationCounter::subsystemCount; ++i)
+        {
+            QJsonObject subsystem;
+            subsystem["allocations_per_frame"] = double(measured.allocations[i]) / measuredFrames;
+            subsystem["bytes_per_frame"] = double(measured.bytes[i]) / measuredFrames;
+            subsystems[AllocationCounter::GetName(static_cast<AllocationCounter::Subsystem>(i))] = subsystem;
+        }
+        result["allocations_by_subsystem"] = subsystems;
+        result["geometry_bytes"] = double(renderer.GetGeometryBytes());
+        result["peak_geometry_bytes"] = double(renderer.GetPeakGeometryBytes());
+        results.append(result);
+        qInfo().noquote() << QString("%1: %2 мс (подготовка %3 мс, QPainter %4 мс; черновой кадр %5 мс), выделений памяти за кадр: %6 (подготовка), %7 (QPainter)")
+                             .arg(result["name"].toString())
+                             .arg(ms, 0, 'f', 2)
+                             .arg(prepareNs / 1e6 / measuredFrames, 0, 'f', 2)
+                             .arg(drawNs / 1e6 / measuredFrames, 0, 'f', 2)
+                             .arg(previewMs, 0, 'f', 2)
+                             .arg(double(prepareAllocations) / measuredFrames, 0, 'f', 1)
+                             .arg(double(drawAllocations) / measuredFrames, 0, 'f', 1);
+        if (prepareAllocations != 0)
+        {
+            qWarning().noquote() << result["name"].toString() << ": подготовка кадра обращается к куче";
+        }
+    }
+    return results;
+}
+
+int Benchmark::Run(QStringList const& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Замеры производительности");
+    parser.addHelpOption();
+    QCommandLineOption benchOption("bench", "Запустить замеры.");
+    parser.addOption(benchOption);
+    parser.addPositionalArgument("file", "Файл JSON с результатами, по умолчанию benchmark.json.", "[file]");
+    parser.process(arguments);
+    if (parser.positionalArguments().size() > 1)
+    {
+        qWarning().noquote() << "Использование: Lab6 --bench [файл.json]";
+        return 1;
+    }
+
+    QJsonObject report;
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["matrix"] = RunMatrix();
+    report["frames"] = RunFrames();
+
+    QFile file(parser.positionalArguments().value(0, "benchmark.json"));
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qWarning().noquote() << file.fileName() << ":" << file.errorString();
+        return 1;
+    }
+    file.write(QJsonDocument(report).toJson());
+    qInfo().noquote() << "Результаты записаны в" << file.fileName();
+    return 0;
+}
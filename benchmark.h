@@ -0,0 +1,15 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonArray>
+#include <QStringList>
+
+class Benchmark
+{
+public:
+    static QJsonArray RunMatrix();
+    static QJsonArray RunFrames();
+    static int Run(QStringList const& arguments);
+};
+
+#endif // BENCHMARK_H
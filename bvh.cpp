@@ -0,0 +1,287 @@
+#include "bvh.h"
+#include "allocationcounter.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+double dot(const double* a, const double* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// start is the smallest line parameter that counts: -infinity for a line,
+// 0 for a half-line.
+bool lineHitsBox(const double* o, const double* d, const double* lo, const double* hi, double radius, double start)
+{
+    double tmin = start;
+    double tmax = std::numeric_limits<double>::infinity();
+    for (int k = 0; k < 3; ++k)
+    {
+        double low = lo[k] - radius;
+        double high = hi[k] + radius;
+        if (std::abs(d[k]) < 1e-12)
+        {
+            if (o[k] < low || o[k] > high)
+            {
+                return false;
+            }
+            continue;
+        }
+        double t1 = (low - o[k]) / d[k];
+        double t2 = (high - o[k]) / d[k];
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+        if (tmin > tmax)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double distanceToLine(const double* o, const double* d, const double* p, double start)
+{
+    double r[3] = {p[0] - o[0], p[1] - o[1], p[2] - o[2]};
+    double t = std::max(dot(r, d) / dot(d, d), start);
+    double perp[3] = {r[0] - t * d[0], r[1] - t * d[1], r[2] - t * d[2]};
+    return std::sqrt(dot(perp, perp));
+}
+
+double distanceToSegment(const double* o, const double* d, const double* a, const double* b, double start)
+{
+    double dd = dot(d, d);
+    double r[3] = {a[0] - o[0], a[1] - o[1], a[2] - o[2]};
+    double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double rt = dot(r, d) / dd;
+    double ut = dot(u, d) / dd;
+    double rp[3] = {r[0] - rt * d[0], r[1] - rt * d[1], r[2] - rt * d[2]};
+    double up[3] = {u[0] - ut * d[0], u[1] - ut * d[1], u[2] - ut * d[2]};
+    double uu = dot(up, up);
+    double s = uu > 1e-18 ? std::clamp(-dot(rp, up) / uu, 0.0, 1.0) : 0.0;
+    if (rt + s * ut < start)
+    {
+        // The closest pair lies before the start of the half-line, so the
+        // closest point of the half-line is its start: the distance is
+        // convex in (t, s) and its minimum moves onto the boundary.
+        double o2[3] = {o[0] + start * d[0], o[1] + start * d[1], o[2] + start * d[2]};
+        double r2[3] = {a[0] - o2[0], a[1] - o2[1], a[2] - o2[2]};
+        double uu2 = dot(u, u);
+        double s2 = uu2 > 1e-18 ? std::clamp(-dot(r2, u) / uu2, 0.0, 1.0) : 0.0;
+        double w2[3] = {r2[0] + s2 * u[0], r2[1] + s2 * u[1], r2[2] + s2 * u[2]};
+        return std::sqrt(dot(w2, w2));
+    }
+    double w[3] = {rp[0] + s * up[0], rp[1] + s * up[1], rp[2] + s * up[2]};
+    return std::sqrt(dot(w, w));
+}
+
+void loadPoint(Point const& p, double* out)
+{
+    out[0] = p.getParameter(0);
+    out[1] = p.getParameter(1);
+    out[2] = p.getParameter(2);
+}
+}
+
+void Bvh::Build(Mesh const& mesh)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    Clear();
+    const Edge* edges = mesh.GetEdges();
+    size_t edgeCount = mesh.GetEdgeCount();
+    if (edgeCount == 0)
+    {
+        return;
+    }
+    std::vector<double> centroids(edgeCount * 3);
+    order.resize(edgeCount);
+    for (size_t i = 0; i < edgeCount; ++i)
+    {
+        order[i] = i;
+        Point a = mesh.GetVertex(edges[i].a);
+        Point b = mesh.GetVertex(edges[i].b);
+        for (int k = 0; k < 3; ++k)
+        {
+            centroids[3 * i + k] = (a.getParameter(k) + b.getParameter(k)) / 2;
+        }
+    }
+    nodes.reserve(2 * edgeCount / leaf_size + 1);
+    build(mesh, centroids, 0, edgeCount);
+}
+
+void Bvh::build(Mesh const& mesh, std::vector<double> const& centroids, int first, int last)
+{
+    int index = nodes.size();
+    nodes.push_back(Node());
+    if (last - first <= leaf_size)
+    {
+        nodes[index].first = first;
+        nodes[index].count = last - first;
+        fitLeaf(mesh, nodes[index]);
+        return;
+    }
+
+    double lo[3], hi[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        lo[k] = hi[k] = centroids[3 * order[first] + k];
+    }
+    for (int i = first; i < last; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::min(lo[k], centroids[3 * order[i] + k]);
+            hi[k] = std::max(hi[k], centroids[3 * order[i] + k]);
+        }
+    }
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (hi[k] - lo[k] > hi[axis] - lo[axis])
+        {
+            axis = k;
+        }
+    }
+    int middle = (first + last) / 2;
+    std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                     [&centroids, axis](int l, int r) { return centroids[3 * l + axis] < centroids[3 * r + axis]; });
+
+    build(mesh, centroids, first, middle);
+    nodes[index].right = nodes.size();
+    build(mesh, centroids, middle, last);
+
+    Node& node = nodes[index];
+    const Node& left = nodes[index + 1];
+    const Node& right = nodes[node.right];
+    for (int k = 0; k < 3; ++k)
+    {
+        node.lo[k] = std::min(left.lo[k], right.lo[k]);
+        node.hi[k] = std::max(left.hi[k], right.hi[k]);
+    }
+}
+
+void Bvh::fitLeaf(Mesh const& mesh, Node& node) const
+{
+    const Edge* edges = mesh.GetEdges();
+    for (int k = 0; k < 3; ++k)
+    {
+        node.lo[k] = std::numeric_limits<double>::infinity();
+        node.hi[k] = -std::numeric_limits<double>::infinity();
+    }
+    for (int i = node.first; i < node.first + node.count; ++i)
+    {
+        const Edge& e = edges[order[i]];
+        Point pa = mesh.GetVertex(e.a);
+        Point pb = mesh.GetVertex(e.b);
+        for (int k = 0; k < 3; ++k)
+        {
+            double a = pa.getParameter(k);
+            double b = pb.getParameter(k);
+            node.lo[k] = std::min({node.lo[k], a, b});
+            node.hi[k] = std::max({node.hi[k], a, b});
+        }
+    }
+}
+
+void Bvh::Refit(Mesh const& mesh)
+{
+    if (order.size() != mesh.GetEdgeCount())
+    {
+        Build(mesh);
+        return;
+    }
+    for (int i = nodes.size() - 1; i >= 0; --i)
+    {
+        Node& node = nodes[i];
+        if (node.count > 0)
+        {
+            fitLeaf(mesh, node);
+            continue;
+        }
+        const Node& left = nodes[i + 1];
+        const Node& right = nodes[node.right];
+        for (int k = 0; k < 3; ++k)
+        {
+            node.lo[k] = std::min(left.lo[k], right.lo[k]);
+            node.hi[k] = std::max(left.hi[k], right.hi[k]);
+        }
+    }
+}
+
+Bvh::Hit Bvh::Pick(Mesh const& mesh, Point const& origin, Point const& direction, double radius, bool halfLine) const
+{
+    Hit hit;
+    if (nodes.empty())
+    {
+        return hit;
+    }
+    const Edge* edges = mesh.GetEdges();
+    double o[3], d[3];
+    loadPoint(origin, o);
+    loadPoint(direction, d);
+    if (dot(d, d) < 1e-18)
+    {
+        return hit;
+    }
+
+    // Geometry behind the start of a half-line (behind the eye in
+    // perspective) can't be seen and must not be picked.
+    const double start = halfLine ? 0.0 : -std::numeric_limits<double>::infinity();
+    double best = radius;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (!lineHitsBox(o, d, node.lo, node.hi, best, start))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top++] = node.right;
+            stack[top++] = &node - nodes.data() + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; ++i)
+        {
+            double a[3], b[3];
+            loadPoint(mesh.GetVertex(edges[order[i]].a), a);
+            loadPoint(mesh.GetVertex(edges[order[i]].b), b);
+            double distance = distanceToSegment(o, d, a, b, start);
+            if (distance <= best)
+            {
+                best = distance;
+                hit.edge = order[i];
+                hit.distance = distance;
+            }
+        }
+    }
+
+    if (hit.edge >= 0)
+    {
+        double a[3], b[3];
+        loadPoint(mesh.GetVertex(edges[hit.edge].a), a);
+        loadPoint(mesh.GetVertex(edges[hit.edge].b), b);
+        double da = distanceToLine(o, d, a, start);
+        double db = distanceToLine(o, d, b, start);
+        if (std::min(da, db) <= radius)
+        {
+            hit.vertex = da <= db ? edges[hit.edge].a : edges[hit.edge].b;
+        }
+    }
+    return hit;
+}
+
+bool Bvh::IsEmpty() const
+{
+    return nodes.empty();
+}
+
+void Bvh::Clear()
+{
+    nodes.clear();
+    order.clear();
+}
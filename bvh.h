@@ -0,0 +1,38 @@
+#ifndef BVH_H
+#define BVH_H
+#include <vector>
+#include "mesh.h"
+
+class Bvh
+{
+public:
+    struct Hit
+    {
+        int edge = -1;
+        int vertex = -1;
+        double distance = 0;
+    };
+    void Build(Mesh const& mesh);
+    void Refit(Mesh const& mesh);
+    // Nearest edge within radius of the line origin + t * direction, or of
+    // its t >= 0 half when halfLine is set.
+    Hit Pick(Mesh const& mesh, Point const& origin, Point const& direction, double radius, bool halfLine = false) const;
+    bool IsEmpty() const;
+    void Clear();
+private:
+    struct Node
+    {
+        double lo[3];
+        double hi[3];
+        int right = 0;
+        int first = 0;
+        int count = 0;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> order;
+    int leaf_size = 4;
+    void build(Mesh const& mesh, std::vector<double> const& centroids, int first, int last);
+    void fitLeaf(Mesh const& mesh, Node& node) const;
+};
+
+#endif // BVH_H
@@ -0,0 +1,214 @@
+#include "deformation.h"
+#include "allocationcounter.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const size_t block = 256;
+const size_t minimumPerThread = 1 << 15;
+const double minimumBend = 1e-9;
+
+// sin and cos without a library call per element, so the block loops stay
+// vectorizable: the angle is reduced to [-pi/4, pi/4] by quadrant, the
+// series run to the 9th and 10th power (error below 2e-9) and the pair is
+// rotated back by the quadrant.
+inline void sinCos(double angle, double& s, double& c)
+{
+    double q = std::floor(angle * (2 / M_PI) + 0.5);
+    double r = angle - q * (M_PI / 2);
+    double r2 = r * r;
+    double sr = r * (1 - r2 / 6 * (1 - r2 / 20 * (1 - r2 / 42 * (1 - r2 / 72))));
+    double cr = 1 - r2 / 2 * (1 - r2 / 12 * (1 - r2 / 30 * (1 - r2 / 56 * (1 - r2 / 90))));
+    long long m = static_cast<long long>(q) & 3;
+    s = (m & 1 ? cr : sr) * (m & 2 ? -1 : 1);
+    c = (m & 1 ? sr : cr) * ((m + 1) & 2 ? -1 : 1);
+}
+
+// Vertices are widened into blocks of coordinates and every stage is a
+// separate loop over the block, so each loop is a flat run of arithmetic.
+template <typename Vertex>
+void deformRange(Deformation const& d, const Vertex* vertices, size_t count,
+                 double const scale[3], double const offset[3], PackedVertex* out)
+{
+    double x[block], y[block], z[block];
+    for (size_t first = 0; first < count; first += block)
+    {
+        size_t n = std::min(block, count - first);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = vertices[first + i].x * scale[0] + offset[0];
+            y[i] = vertices[first + i].y * scale[1] + offset[1];
+            z[i] = vertices[first + i].z * scale[2] + offset[2] - d.center;
+        }
+        if (d.taper != 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                double k = 1 + d.taper * z[i];
+                x[i] *= k;
+                y[i] *= k;
+            }
+        }
+        if (d.twist != 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                double s, c;
+                sinCos(d.twist * z[i], s, c);
+                double rx = x[i] * c - y[i] * s;
+                y[i] = x[i] * s + y[i] * c;
+                x[i] = rx;
+            }
+        }
+        if (std::abs(d.bend) > minimumBend)
+        {
+            double radius = 1 / d.bend;
+            for (size_t i = 0; i < n; ++i)
+            {
+                double s, c;
+                sinCos(d.bend * z[i], s, c);
+                double arm = radius - x[i];
+                x[i] = radius - arm * c;
+                z[i] = arm * s;
+            }
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[first + i] = {float(x[i]), float(y[i]), float(z[i] + d.center)};
+        }
+    }
+}
+
+struct Interval
+{
+    double lo;
+    double hi;
+};
+
+Interval sorted(double a, double b)
+{
+    return {std::min(a, b), std::max(a, b)};
+}
+
+Interval operator*(Interval a, Interval b)
+{
+    double p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+    return {*std::min_element(p, p + 4), *std::max_element(p, p + 4)};
+}
+
+// Whether phase + 2 pi n lies in the interval for some integer n.
+bool reaches(Interval angle, double phase)
+{
+    return std::ceil((angle.lo - phase) / (2 * M_PI)) <= (angle.hi - phase) / (2 * M_PI);
+}
+
+Interval cosRange(Interval angle)
+{
+    Interval res = sorted(std::cos(angle.lo), std::cos(angle.hi));
+    return {reaches(angle, M_PI) ? -1 : res.lo, reaches(angle, 0) ? 1 : res.hi};
+}
+
+Interval sinRange(Interval angle)
+{
+    Interval res = sorted(std::sin(angle.lo), std::sin(angle.hi));
+    return {reaches(angle, -M_PI / 2) ? -1 : res.lo, reaches(angle, M_PI / 2) ? 1 : res.hi};
+}
+
+struct DeformedData
+{
+    std::vector<PackedVertex> vertices;
+    Mesh source;
+};
+}
+
+bool Deformation::IsIdentity() const
+{
+    return taper == 0 && twist == 0 && std::abs(bend) <= minimumBend;
+}
+
+void Deformation::Apply(Mesh const& mesh, PackedVertex* out) const
+{
+    TRACE_SCOPE("transform", "Deformation::Apply");
+    double scale[3] = {1, 1, 1};
+    double offset[3] = {0, 0, 0};
+    if (mesh.GetVertexFormat() == Mesh::VertexFormat::Quantized16)
+    {
+        std::copy(mesh.GetQuantization().scale, mesh.GetQuantization().scale + 3, scale);
+        std::copy(mesh.GetQuantization().offset, mesh.GetQuantization().offset + 3, offset);
+    }
+    // The back copy of an extrusion no longer follows from the front one
+    // once the map is nonlinear, so it is deformed from the moved profile.
+    size_t stored = mesh.GetStoredVertexCount();
+    for (int part = 0; part < (mesh.IsExtrusion() ? 2 : 1); ++part)
+    {
+        double moved[3] = {offset[0], offset[1], offset[2]};
+        if (part == 1)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                moved[k] += mesh.GetExtrusion().getParameter(k);
+            }
+        }
+        PackedVertex* target = out + part * stored;
+        Parallel::For(stored, minimumPerThread, [&](size_t first, size_t last)
+        {
+            if (mesh.GetVertexFormat() == Mesh::VertexFormat::Float)
+            {
+                deformRange(*this, static_cast<const PackedVertex*>(mesh.GetVertexData()) + first, last - first, scale, moved, target + first);
+            }
+            else
+            {
+                deformRange(*this, static_cast<const QuantizedVertex*>(mesh.GetVertexData()) + first, last - first, scale, moved, target + first);
+            }
+        });
+    }
+}
+
+Mesh Deformation::Deform(Mesh const& mesh) const
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto data = std::make_shared<DeformedData>();
+    data->vertices.resize(mesh.GetVertexCount());
+    data->source = mesh;
+    Apply(mesh, data->vertices.data());
+    return Mesh::FromBuffers(data->vertices.data(), Mesh::VertexFormat::Float, Mesh::Quantization(), data->vertices.size(),
+                             mesh.GetEdges(), mesh.GetEdgeCount(), data);
+}
+
+// Interval arithmetic over the same stages as deformRange. Each stage is
+// bounded on its own, so the box is conservative rather than tight.
+void Deformation::Bound(double lo[3], double hi[3]) const
+{
+    Interval x{lo[0], hi[0]};
+    Interval y{lo[1], hi[1]};
+    Interval t{lo[2] - center, hi[2] - center};
+    if (taper != 0)
+    {
+        Interval k = sorted(1 + taper * t.lo, 1 + taper * t.hi);
+        x = x * k;
+        y = y * k;
+    }
+    if (twist != 0)
+    {
+        double r = std::sqrt(std::max(x.lo * x.lo, x.hi * x.hi) + std::max(y.lo * y.lo, y.hi * y.hi));
+        x = y = {-r, r};
+    }
+    if (std::abs(bend) > minimumBend)
+    {
+        Interval angle = sorted(bend * t.lo, bend * t.hi);
+        double radius = 1 / bend;
+        Interval arm{radius - x.hi, radius - x.lo};
+        Interval c = arm * cosRange(angle);
+        x = {radius - c.hi, radius - c.lo};
+        t = arm * sinRange(angle);
+    }
+    lo[0] = x.lo;
+    hi[0] = x.hi;
+    lo[1] = y.lo;
+    hi[1] = y.hi;
+    lo[2] = t.lo + center;
+    hi[2] = t.hi + center;
+}
@@ -0,0 +1,30 @@
+#ifndef DEFORMATION_H
+#define DEFORMATION_H
+
+#include "matrix.h"
+#include "mesh.h"
+
+// Nonlinear model-space deformations applied per vertex before the affine
+// transform. All of them act along z, measured from the plane z = center,
+// and are applied in this order:
+//   taper: x and y of every slice scale by 1 + taper * (z - center);
+//   twist: every slice turns about z by twist * (z - center) radians;
+//   bend:  the z axis bends into an arc of curvature bend in the xz plane.
+// The parameters are plain values, so they can change every frame without
+// touching the mesh.
+struct Deformation
+{
+    double taper = 0;
+    double twist = 0;
+    double bend = 0;
+    double center = 0;
+    bool IsIdentity() const;
+    // Writes all GetVertexCount() vertices of mesh, deformed, to out.
+    void Apply(Mesh const& mesh, PackedVertex* out) const;
+    // A plain mesh over the deformed vertices with the same edges.
+    Mesh Deform(Mesh const& mesh) const;
+    // Widens the box lo..hi to hold the deformed image of every point in it.
+    void Bound(double lo[3], double hi[3]) const;
+};
+
+#endif // DEFORMATION_H
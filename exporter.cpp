@@ -0,0 +1,184 @@
+#include "exporter.h"
+#include "renderer.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <QSvgGenerator>
+#include <thread>
+
+namespace
+{
+struct ViewSpec
+{
+    const char* suffix;
+    int projection;
+};
+
+const ViewSpec views[] = {
+    {"front", static_cast<int>(Matrix::ProjectionType::ProjectionOXY)},
+    {"top", static_cast<int>(Matrix::ProjectionType::ProjectionOXZ)},
+    {"profile", static_cast<int>(Matrix::ProjectionType::ProjectionOYZ)},
+    {"axonometric", -1},
+};
+
+bool renderView(Renderer const& prototype, ViewSpec const& spec, QString const& base, Exporter::Options const& options)
+{
+    Renderer renderer(prototype);
+    renderer.SetProjection(spec.projection);
+    // Prepared once; the PNG and the SVG are painted from the same polylines.
+    renderer.PrepareFrame(options.size);
+    bool ok = true;
+    if (options.formats & Exporter::Png)
+    {
+        QImage image(options.size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        renderer.Draw(painter, options.size);
+        painter.end();
+        ok = image.save(base + "_" + spec.suffix + ".png") && ok;
+    }
+    if (options.formats & Exporter::Svg)
+    {
+        QSvgGenerator generator;
+        generator.setFileName(base + "_" + spec.suffix + ".svg");
+        generator.setSize(options.size);
+        generator.setViewBox(QRect(QPoint(0, 0), options.size));
+        QPainter painter(&generator);
+        renderer.Draw(painter, options.size);
+        ok = painter.end() && ok;
+    }
+    return ok;
+}
+}
+
+Renderer Exporter::CreateRenderer(Mesh const& mesh, SceneFile::View const& view, QSize size)
+{
+    Renderer renderer;
+    if (view.stripOrdered)
+    {
+        renderer.SetStripMesh(mesh);
+    }
+    else
+    {
+        renderer.SetMesh(mesh);
+    }
+    renderer.TransformFigure(view.transform);
+    renderer.SetPointCloud(mesh.GetEdgeCount() == 0);
+    renderer.SetRotation(view.angleX, view.angleY, view.angleZ);
+    renderer.SetPerspective(view.focalLength, view.nearDistance);
+    renderer.SetUnit(view.unit > 0 ? view.unit : std::min(size.width(), size.height()) / 20);
+    return renderer;
+}
+
+bool Exporter::ExportScene(QString const& name, Mesh const& mesh, SceneFile::View const& view,
+                           Options const& options, QString* error)
+{
+    // The saved transform is applied once, into one read-only buffer that
+    // every view thread only projects from.
+    SceneFile::View worldView = view;
+    worldView.transform = Matrix::GetIdentityMatrix();
+    Renderer prototype = CreateRenderer(mesh.Transformed(view.transform), worldView, options.size);
+
+    QString base = QDir(options.outputDirectory).filePath(name);
+    const int count = sizeof(views) / sizeof(views[0]);
+    bool results[count];
+    std::vector<std::thread> workers;
+    for (int i = 0; i < count; ++i)
+    {
+        workers.emplace_back([&, i]() { results[i] = renderView(prototype, views[i], base, options); });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (!results[i])
+        {
+            if (error)
+            {
+                *error = QString("Не удалось записать %1_%2").arg(base, views[i].suffix);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+int Exporter::Run(QStringList const& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Пакетный экспорт проекций");
+    parser.addHelpOption();
+    QCommandLineOption exportOption("export", "Каталог для экспортированных изображений.", "directory");
+    QCommandLineOption formatOption("format", "Форматы через запятую: png, svg.", "formats", "png");
+    QCommandLineOption sizeOption("size", "Размер изображения WxH.", "size", "1000x800");
+    parser.addOption(exportOption);
+    parser.addOption(formatOption);
+    parser.addOption(sizeOption);
+    parser.addPositionalArgument("scenes", "Файлы сцен или каталоги со сценами.");
+    parser.process(arguments);
+
+    Options options;
+    options.outputDirectory = parser.value(exportOption);
+    options.formats = 0;
+    for (QString const& format : parser.value(formatOption).split(','))
+    {
+        if (format.trimmed().toLower() == "png")
+        {
+            options.formats |= Png;
+        }
+        else if (format.trimmed().toLower() == "svg")
+        {
+            options.formats |= Svg;
+        }
+    }
+    QStringList size = parser.value(sizeOption).split('x');
+    if (size.size() == 2 && size[0].toInt() > 0 && size[1].toInt() > 0)
+    {
+        options.size = QSize(size[0].toInt(), size[1].toInt());
+    }
+    if (options.formats == 0 || parser.positionalArguments().isEmpty() || !QDir().mkpath(options.outputDirectory))
+    {
+        qWarning().noquote() << "Использование: Lab6 --export <каталог> [--format png,svg] [--size WxH] <сцены...>";
+        return 1;
+    }
+
+    QStringList scenes;
+    for (QString const& argument : parser.positionalArguments())
+    {
+        QFileInfo info(argument);
+        if (info.isDir())
+        {
+            QDir dir(argument);
+            for (QString const& entry : dir.entryList({"*.l6scene"}, QDir::Files))
+            {
+                scenes.push_back(dir.filePath(entry));
+            }
+        }
+        else
+        {
+            scenes.push_back(argument);
+        }
+    }
+
+    int failures = 0;
+    for (QString const& path : scenes)
+    {
+        Mesh mesh;
+        SceneFile::View view;
+        QString error;
+        if (!SceneFile::Load(path, mesh, view, &error)
+            || !ExportScene(QFileInfo(path).completeBaseName(), mesh, view, options, &error))
+        {
+            qWarning().noquote() << path << ":" << error;
+            ++failures;
+            continue;
+        }
+        qInfo().noquote() << path << "->" << options.outputDirectory;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include "mesh.h"
+#include "renderer.h"
+#include "scenefile.h"
+
+class Exporter
+{
+public:
+    enum Format
+    {
+        Png = 1,
+        Svg = 2,
+    };
+    struct Options
+    {
+        QString outputDirectory;
+        int formats = Png;
+        QSize size = QSize(1000, 800);
+    };
+    // A renderer showing the scene the way it was saved. It shares the
+    // loaded mesh and applies the model transform per frame, as PlotArea
+    // does; ExportScene passes a mesh already moved by the transform.
+    static Renderer CreateRenderer(Mesh const& mesh, SceneFile::View const& view, QSize size);
+    static bool ExportScene(QString const& name, Mesh const& mesh, SceneFile::View const& view,
+                            Options const& options, QString* error = nullptr);
+    static int Run(QStringList const& arguments);
+};
+
+#endif // EXPORTER_H
@@ -0,0 +1,64 @@
+#include "framearena.h"
+
+FrameArena::FrameArena(size_t capacity):
+    buffer(capacity)
+{
+    resource.emplace(buffer.data(), buffer.size(), &upstream);
+}
+
+FrameArena::FrameArena(FrameArena const& other):
+    FrameArena(other.GetCapacity())
+{
+}
+
+FrameArena& FrameArena::operator=(FrameArena const& other)
+{
+    if (&other != this)
+    {
+        resource.reset();
+        upstream.requested = 0;
+        buffer.assign(other.GetCapacity(), std::byte(0));
+        resource.emplace(buffer.data(), buffer.size(), &upstream);
+    }
+    return *this;
+}
+
+std::pmr::memory_resource* FrameArena::Resource()
+{
+    return &*resource;
+}
+
+void FrameArena::Reset()
+{
+    if (upstream.requested == 0)
+    {
+        resource->release();
+        return;
+    }
+    size_t capacity = (buffer.size() + upstream.requested) * 2;
+    resource.reset();
+    upstream.requested = 0;
+    buffer.assign(capacity, std::byte(0));
+    resource.emplace(buffer.data(), buffer.size(), &upstream);
+}
+
+size_t FrameArena::GetCapacity() const
+{
+    return buffer.size();
+}
+
+void* FrameArena::Upstream::do_allocate(size_t bytes, size_t alignment)
+{
+    requested += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void FrameArena::Upstream::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool FrameArena::Upstream::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+{
+    return this == &other;
+}
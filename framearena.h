@@ -0,0 +1,38 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+template <typename T>
+using FrameVector = std::pmr::vector<T>;
+
+// Monotonic buffer for temporaries that live for one frame. Reset() rewinds
+// it; if the previous frame spilled to the heap, the buffer grows to the
+// high-water mark so that steady-state frames are served without allocating.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 64 * 1024);
+    FrameArena(FrameArena const& other);
+    FrameArena& operator=(FrameArena const& other);
+    std::pmr::memory_resource* Resource();
+    void Reset();
+    size_t GetCapacity() const;
+private:
+    class Upstream : public std::pmr::memory_resource
+    {
+    public:
+        size_t requested = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+    };
+    std::vector<std::byte> buffer;
+    Upstream upstream;
+    std::optional<std::pmr::monotonic_buffer_resource> resource;
+};
+
+#endif // FRAMEARENA_H
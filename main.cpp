@@ -1,10 +1,75 @@
 #include "mainwindow.h"
+#include "exporter.h"
+#include "benchmark.h"
+#include "regression.h"
+#include "turntable.h"
+#include "stream.h"
+#include "trace.h"
 
 #include <QApplication>
+#include <QGuiApplication>
+
+static bool hasOption(int argc, char *argv[], const char *option)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (QByteArray(argv[i]).startsWith(option))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void useOffscreenPlatform()
+{
+#ifdef Q_OS_LINUX
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM") && !qEnvironmentVariableIsSet("DISPLAY")
+        && !qEnvironmentVariableIsSet("WAYLAND_DISPLAY"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+}
 
 int main(int argc, char *argv[])
 {
+    if (hasOption(argc, argv, "--bench"))
+    {
+        useOffscreenPlatform();
+        QGuiApplication a(argc, argv);
+        Trace::Session trace(QCoreApplication::arguments());
+        return Benchmark::Run(trace.Arguments());
+    }
+    if (hasOption(argc, argv, "--regression"))
+    {
+        useOffscreenPlatform();
+        QGuiApplication a(argc, argv);
+        Trace::Session trace(QCoreApplication::arguments());
+        return Regression::Run(trace.Arguments());
+    }
+    if (hasOption(argc, argv, "--export"))
+    {
+        useOffscreenPlatform();
+        QGuiApplication a(argc, argv);
+        Trace::Session trace(QCoreApplication::arguments());
+        return Exporter::Run(trace.Arguments());
+    }
+    if (hasOption(argc, argv, "--turntable"))
+    {
+        useOffscreenPlatform();
+        QGuiApplication a(argc, argv);
+        Trace::Session trace(QCoreApplication::arguments());
+        return Turntable::Run(trace.Arguments());
+    }
+    if (hasOption(argc, argv, "--produce"))
+    {
+        QCoreApplication a(argc, argv);
+        Trace::Session trace(QCoreApplication::arguments());
+        return Stream::Run(trace.Arguments());
+    }
     QApplication a(argc, argv);
+    Trace::Session trace(QCoreApplication::arguments());
     MainWindow w;
     w.show();
     return a.exec();
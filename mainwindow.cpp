@@ -2,11 +2,20 @@
 #include "ui_mainwindow.h"
 #include <QGridLayout>
 #include <cmath>
+#include <array>
 #include <QDialog>
 #include <QDoubleValidator>
 #include <QLineEdit>
 #include <QFormLayout>
 #include <QDialogButtonBox>
+#include <QStatusBar>
+#include <QMenuBar>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QMessageBox>
+#include <QApplication>
+#include "scenefile.h"
+#include "trace.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -15,6 +24,40 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
     QGridLayout *g = new QGridLayout;
     area = new PlotArea;
+    animation = new Animation(this);
+    AnimationButton = new QPushButton("Анимация");
+    AnimationButton -> setCheckable(true);
+    MultiViewButton = new QPushButton("Четыре вида");
+    MultiViewButton -> setCheckable(true);
+    PointCloudButton = new QPushButton("Облако точек");
+    PointCloudButton -> setCheckable(true);
+    AnimationStats = new QLabel;
+    RenderStats = new QLabel;
+    AllocationStats = new QLabel;
+    StreamStats = new QLabel;
+    PerspectiveButton = new QPushButton("Центральная проекция");
+    CavalierButton = new QPushButton("Кавальерная проекция");
+    CabinetButton = new QPushButton("Кабинетная проекция");
+    FitButton = new QPushButton("Вписать в окно");
+    DeformButton = new QPushButton("Деформация");
+    FocalLength = new QDoubleSpinBox;
+    FocalLength -> setPrefix("f = ");
+    FocalLength -> setRange(1, 100);
+    FocalLength -> setSingleStep(0.5);
+    FocalLength -> setValue(area -> GetFocalLength());
+    statusBar() -> addPermanentWidget(AnimationStats);
+    statusBar() -> addPermanentWidget(RenderStats);
+    statusBar() -> addPermanentWidget(AllocationStats);
+    statusBar() -> addPermanentWidget(StreamStats);
+    QMenu *fileMenu = menuBar() -> addMenu("Файл");
+    fileMenu -> addAction("Открыть сцену...", QKeySequence::Open, this, &MainWindow::OpenScene);
+    fileMenu -> addAction("Сохранить сцену...", QKeySequence::Save, this, &MainWindow::SaveScene);
+    fileMenu -> addAction("Подключить поток...", this, &MainWindow::AttachStream);
+    fileMenu -> addAction("Отключить поток", this, &MainWindow::DetachStream);
+    if (Trace::IsEnabled())
+    {
+        fileMenu -> addAction("Записать трассировку", QKeySequence(Qt::Key_F12), this, &MainWindow::DumpTrace);
+    }
     g -> addWidget(area,                           0, 0, 16, 5);
     g -> addWidget(ui -> TransformationMatrixLabel, 0, 8, 1, 3);
     g -> addWidget(ui -> TransformationMatrix,     1, 8, 1, 3);
@@ -35,6 +78,15 @@ MainWindow::MainWindow(QWidget *parent)
     g -> addWidget(ui -> ProjectionOYZ,            13, 8, 1, 2);
     g -> addWidget(ui -> RevertProjection,         14, 8, 1, 2);
     g -> addWidget(ui -> RevertButton,             15, 8, 1, 2);
+    g -> addWidget(AnimationButton,                16, 8, 1, 2);
+    g -> addWidget(MultiViewButton,                17, 8, 1, 2);
+    g -> addWidget(PerspectiveButton,              11, 10, 1, 1);
+    g -> addWidget(CavalierButton,                 12, 10, 1, 1);
+    g -> addWidget(CabinetButton,                  13, 10, 1, 1);
+    g -> addWidget(FocalLength,                    14, 10, 1, 1);
+    g -> addWidget(FitButton,                      15, 10, 1, 1);
+    g -> addWidget(DeformButton,                   16, 10, 1, 1);
+    g -> addWidget(PointCloudButton,               17, 10, 1, 1);
 
     UpdateTransformationMatrix();
     centralWidget()->setLayout(g);
@@ -47,6 +99,63 @@ MainWindow::MainWindow(QWidget *parent)
         {Point(2, 1.5, 1), Point(3.5, 1.5, 1), Point(3.5, 2.5, 1), Point(2, 2.5, 1), Point(2, 1.5, 1),
          Point(2, 1.5, 2), Point(3.5, 1.5, 2), Point(3.5, 2.5, 2), Point(2, 2.5, 2), Point(2, 1.5, 2)});
 
+    animation -> AddKeyframe({0, QQuaternion(), QVector3D(1, 1, 1), QVector3D(0, 0, 0)});
+    animation -> AddKeyframe({2, QQuaternion::fromAxisAndAngle(0, 1, 0, 120), QVector3D(1.3, 1.3, 1.3), QVector3D(0, 0, 0)});
+    animation -> AddKeyframe({4, QQuaternion::fromAxisAndAngle(0, 1, 0, 240), QVector3D(1, 1, 1), QVector3D(0, 0, 0)});
+    animation -> AddKeyframe({6, QQuaternion::fromAxisAndAngle(0, 1, 0, 360), QVector3D(1, 1, 1), QVector3D(0, 0, 0)});
+    connect(AnimationButton, &QPushButton::toggled, this, &MainWindow::ToggleAnimation);
+    connect(MultiViewButton, &QPushButton::toggled, this, &MainWindow::ToggleMultiView);
+    connect(PointCloudButton, &QPushButton::toggled, this, &MainWindow::TogglePointCloud);
+    connect(PerspectiveButton, &QPushButton::clicked, this, &MainWindow::ProjectPerspective);
+    connect(CavalierButton, &QPushButton::clicked, this, &MainWindow::ProjectCavalier);
+    connect(CabinetButton, &QPushButton::clicked, this, &MainWindow::ProjectCabinet);
+    connect(FitButton, &QPushButton::clicked, this, &MainWindow::FitToView);
+    connect(DeformButton, &QPushButton::clicked, this, &MainWindow::ShowDeformDialog);
+    connect(FocalLength, &QDoubleSpinBox::valueChanged, this, &MainWindow::ChangeFocalLength);
+    connect(animation, &Animation::FrameChanged, this, [this](Matrix const& transform)
+    {
+        area -> SetAnimationTransform(transform);
+        area -> repaint();
+    });
+    connect(animation, &Animation::StatsChanged, this, [this]()
+    {
+        AnimationStats -> setText(QString("%1 / %2 fps, пропущено кадров: %3")
+                                  .arg(animation -> GetAchievedFps(), 0, 'f', 1)
+                                  .arg(animation -> GetTargetFps())
+                                  .arg(animation -> GetDroppedFrames()));
+    });
+    connect(area, &PlotArea::FrameRendered, this, [this]()
+    {
+        Renderer::QualityStats preview = area -> GetQualityStats(Renderer::Quality::Preview);
+        Renderer::QualityStats refined = area -> GetQualityStats(Renderer::Quality::Refined);
+        RenderStats -> setText(QString("черновой кадр: %1 мс, чистовой: %2 мс")
+                               .arg(preview.lastMs, 0, 'f', 1)
+                               .arg(refined.lastMs, 0, 'f', 1));
+        StreamStats -> setText(area -> IsStreaming()
+                               ? QString("поток: кадр %1, задержка %2 мс, пропущено %3")
+                                 .arg(area -> GetStreamFrame())
+                                 .arg(area -> GetStreamLatency(), 0, 'f', 1)
+                                 .arg(area -> GetSkippedStreamFrames())
+                               : QString());
+        updateAllocationStats();
+    });
+    actionStart = AllocationCounter::GetCounts();
+    qApp -> installEventFilter(this);
+    connect(area, &PlotArea::SelectionChanged, this, [this]()
+    {
+        if (area -> GetSelectedVertex() >= 0)
+        {
+            statusBar() -> showMessage("Выбрана вершина " + QString::number(area -> GetSelectedVertex()));
+        }
+        else if (area -> GetSelectedEdge() >= 0)
+        {
+            statusBar() -> showMessage("Выбрано ребро " + QString::number(area -> GetSelectedEdge()));
+        }
+        else
+        {
+            statusBar() -> clearMessage();
+        }
+    });
 }
 
 MainWindow::~MainWindow()
@@ -106,54 +215,11 @@ void MainWindow::on_OZRight_clicked()
 
 void MainWindow::on_ScaleButton_clicked()
 {
-    QDialog *d = new QDialog();
-    d->setWindowTitle("Масштабирование");
-    QString prompts[3] = {"x", "y", "z"};
-    QLabel *labels[3];
-    QLineEdit *edits[3];
-    QDoubleValidator *val = new QDoubleValidator(-5, 5, 2);
-    val -> setNotation(QDoubleValidator::StandardNotation);
-    QGridLayout *l = new QGridLayout(d);
-    for (int i = 0; i < 3; ++i)
+    if (!ScaleDialog)
     {
-        labels[i] = new QLabel("Масштабирование по " + prompts[i]);
-        edits[i] = new QLineEdit("1");
-        edits[i] -> setValidator(val);
-        l -> addWidget(labels[i], i, 0, 1, 1);
-        l -> addWidget(edits[i], i, 1, 1, 1);
+        ScaleDialog = createTransformDialog("Масштабирование", "Масштабирование по ", 1, 5, &Matrix::GetScaleMatrix);
     }
-    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
-                                         | QDialogButtonBox::Cancel);
-    l -> addWidget(buttonBox, 3, 0, 1, 2);
-    connect(buttonBox, &QDialogButtonBox::accepted, d, &QDialog::accept);
-    connect(buttonBox, &QDialogButtonBox::rejected, d, &QDialog::reject);
-    if (d->exec())
-    {
-        double scales[3];
-        for (int i = 0; i < 3; ++i)
-        {
-            bool ok;
-            scales[i] = edits[i]->text().replace(',', '.').toDouble(&ok);
-            if (!ok)
-            {
-                scales[i] = 1;
-            }
-        }
-        area -> TransformFigure(Matrix::GetScaleMatrix(scales[0], scales[1], scales[2]));
-        area -> repaint();
-        UpdateTransformationMatrix();
-    }
-    for (int i = 0; i < 3; ++i)
-    {
-        delete labels[i];
-        delete edits[i];
-        labels[i] = nullptr;
-        edits[i] = nullptr;
-    }
-    delete l;
-    delete buttonBox;
-    delete d;
-    delete val;
+    showTransformDialog(ScaleDialog, TranslateDialog);
 }
 
 void MainWindow::on_RevertButton_clicked()
@@ -171,54 +237,88 @@ void MainWindow::UpdateTransformationMatrix()
 
 void MainWindow::on_TranslateButton_clicked()
 {
-    QDialog *d = new QDialog();
-    d->setWindowTitle("Перенос");
+    if (!TranslateDialog)
+    {
+        TranslateDialog = createTransformDialog("Перенос", "Перенос по ", 0, 9, &Matrix::GetTranslationMatrix);
+    }
+    showTransformDialog(TranslateDialog, ScaleDialog);
+}
+
+QDialog *MainWindow::createTransformDialog(QString const& title, QString const& prompt, double value, double limit,
+                                           Matrix (*factory)(double, double, double))
+{
+    QDialog *d = new QDialog(this);
+    d -> setWindowTitle(title);
+    d -> setModal(false);
     QString prompts[3] = {"x", "y", "z"};
-    QLabel *labels[3];
-    QLineEdit *edits[3];
-    QDoubleValidator *val = new QDoubleValidator(-9, 9, 2);
-    val -> setNotation(QDoubleValidator::StandardNotation);
+    std::array<QDoubleSpinBox *, 3> edits;
     QGridLayout *l = new QGridLayout(d);
     for (int i = 0; i < 3; ++i)
     {
-        labels[i] = new QLabel("Перенос по " + prompts[i]);
-        edits[i] = new QLineEdit("0");
-        edits[i] -> setValidator(val);
-        l -> addWidget(labels[i], i, 0, 1, 1);
+        edits[i] = new QDoubleSpinBox;
+        edits[i] -> setRange(-limit, limit);
+        edits[i] -> setDecimals(2);
+        edits[i] -> setSingleStep(0.1);
+        edits[i] -> setValue(value);
+        l -> addWidget(new QLabel(prompt + prompts[i]), i, 0, 1, 1);
         l -> addWidget(edits[i], i, 1, 1, 1);
     }
-    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
-                                         | QDialogButtonBox::Cancel);
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Apply
+                                         | QDialogButtonBox::Reset
+                                         | QDialogButtonBox::Close);
     l -> addWidget(buttonBox, 3, 0, 1, 2);
-    connect(buttonBox, &QDialogButtonBox::accepted, d, &QDialog::accept);
-    connect(buttonBox, &QDialogButtonBox::rejected, d, &QDialog::reject);
-    if (d->exec())
+
+    // The preview sits on top of the committed transform and only costs one
+    // extra 4x4 product per frame; update() coalesces bursts of valueChanged.
+    auto current = [edits, factory]()
     {
-        double translations[3];
-        for (int i = 0; i < 3; ++i)
+        return factory(edits[0] -> value(), edits[1] -> value(), edits[2] -> value());
+    };
+    auto restore = [this, edits, value]()
+    {
+        TRACE_SCOPE("dialog", "reset transform");
+        for (QDoubleSpinBox *edit : edits)
         {
-            bool ok;
-            translations[i] = edits[i]->text().replace(',', '.').toDouble(&ok);
-            if (!ok)
-            {
-                translations[i] = 0;
-            }
+            edit -> blockSignals(true);
+            edit -> setValue(value);
+            edit -> blockSignals(false);
         }
-        area -> TransformFigure(Matrix::GetTranslationMatrix(translations[0], translations[1], translations[2]));
-        area -> repaint();
+        area -> ResetPreviewTransform();
         UpdateTransformationMatrix();
+        area -> update();
+    };
+    for (QDoubleSpinBox *edit : edits)
+    {
+        connect(edit, &QDoubleSpinBox::valueChanged, this, [this, current]()
+        {
+            TRACE_SCOPE("dialog", "preview transform");
+            area -> SetPreviewTransform(current());
+            UpdateTransformationMatrix();
+            area -> update();
+        });
     }
-    for (int i = 0; i < 3; ++i)
+    connect(buttonBox -> button(QDialogButtonBox::Apply), &QPushButton::clicked, this, [this, current, restore]()
+    {
+        TRACE_SCOPE("dialog", "apply transform");
+        area -> TransformFigure(current());
+        restore();
+    });
+    connect(buttonBox -> button(QDialogButtonBox::Reset), &QPushButton::clicked, this, restore);
+    connect(buttonBox, &QDialogButtonBox::rejected, d, &QDialog::reject);
+    connect(d, &QDialog::rejected, this, restore);
+    return d;
+}
+
+void MainWindow::showTransformDialog(QDialog *dialog, QDialog *other)
+{
+    TRACE_SCOPE("dialog", "showTransformDialog");
+    if (other && other -> isVisible())
     {
-        delete labels[i];
-        delete edits[i];
-        labels[i] = nullptr;
-        edits[i] = nullptr;
+        other -> reject();
     }
-    delete l;
-    delete buttonBox;
-    delete d;
-    delete val;
+    dialog -> show();
+    dialog -> raise();
+    dialog -> activateWindow();
 }
 
 void MainWindow::on_ProjectionOXY_clicked()
@@ -248,9 +348,275 @@ void MainWindow::on_ProjectionOYZ_clicked()
 }
 
 
+void MainWindow::ProjectPerspective()
+{
+    area -> RevertProjection();
+    area -> ProjectFigure(Matrix::ProjectionType::ProjectionPerspective);
+    UpdateTransformationMatrix();
+    area -> repaint();
+}
+
+
+void MainWindow::ProjectCavalier()
+{
+    area -> RevertProjection();
+    area -> ProjectFigure(Matrix::ProjectionType::ProjectionCavalier);
+    UpdateTransformationMatrix();
+    area -> repaint();
+}
+
+
+void MainWindow::ProjectCabinet()
+{
+    area -> RevertProjection();
+    area -> ProjectFigure(Matrix::ProjectionType::ProjectionCabinet);
+    UpdateTransformationMatrix();
+    area -> repaint();
+}
+
+
+void MainWindow::ChangeFocalLength(double value)
+{
+    area -> SetPerspective(value, area -> GetNearDistance());
+    UpdateTransformationMatrix();
+    area -> repaint();
+}
+
+
 void MainWindow::on_RevertProjection_clicked()
 {
     area -> RevertProjection();
     UpdateTransformationMatrix();
     area -> repaint();
 }
+
+
+void MainWindow::ToggleAnimation(bool checked)
+{
+    if (checked)
+    {
+        animation -> Start();
+    }
+    else
+    {
+        animation -> Stop();
+        area -> ResetAnimationTransform();
+        AnimationStats -> clear();
+        area -> repaint();
+    }
+}
+
+void MainWindow::ToggleMultiView(bool checked)
+{
+    area -> SetMultiView(checked);
+    area -> repaint();
+}
+
+void MainWindow::TogglePointCloud(bool checked)
+{
+    area -> SetPointCloud(checked);
+    area -> repaint();
+}
+
+void MainWindow::FitToView()
+{
+    area -> FitToView();
+}
+
+void MainWindow::ShowDeformDialog()
+{
+    if (!DeformDialog)
+    {
+        DeformDialog = createDeformDialog();
+    }
+    DeformDialog -> show();
+    DeformDialog -> raise();
+}
+
+// Every change goes straight to the renderer: the mesh is never rebuilt, so
+// the parameters can be dragged at the preview frame rate.
+QDialog *MainWindow::createDeformDialog()
+{
+    QDialog *d = new QDialog(this);
+    d -> setWindowTitle("Деформация");
+    d -> setModal(false);
+    struct Parameter
+    {
+        QString prompt;
+        double limit;
+        double step;
+        double Deformation::*field;
+    };
+    const Parameter parameters[4] = {
+        {"Сужение, 1/ед.", 1, 0.02, &Deformation::taper},
+        {"Кручение, рад/ед.", 3, 0.05, &Deformation::twist},
+        {"Изгиб, 1/ед.", 1, 0.02, &Deformation::bend},
+        {"Центр по z", 20, 0.5, &Deformation::center},
+    };
+    std::array<QDoubleSpinBox *, 4> edits;
+    QGridLayout *l = new QGridLayout(d);
+    for (int i = 0; i < 4; ++i)
+    {
+        edits[i] = new QDoubleSpinBox;
+        edits[i] -> setRange(-parameters[i].limit, parameters[i].limit);
+        edits[i] -> setDecimals(2);
+        edits[i] -> setSingleStep(parameters[i].step);
+        edits[i] -> setValue(area -> GetDeformation().*parameters[i].field);
+        l -> addWidget(new QLabel(parameters[i].prompt), i, 0, 1, 1);
+        l -> addWidget(edits[i], i, 1, 1, 1);
+    }
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Reset | QDialogButtonBox::Close);
+    l -> addWidget(buttonBox, 4, 0, 1, 2);
+
+    auto apply = [this, edits]()
+    {
+        TRACE_SCOPE("dialog", "deform");
+        Deformation deformation;
+        deformation.taper = edits[0] -> value();
+        deformation.twist = edits[1] -> value();
+        deformation.bend = edits[2] -> value();
+        deformation.center = edits[3] -> value();
+        area -> SetDeformation(deformation);
+        area -> update();
+    };
+    for (QDoubleSpinBox *edit : edits)
+    {
+        connect(edit, &QDoubleSpinBox::valueChanged, this, apply);
+    }
+    connect(buttonBox -> button(QDialogButtonBox::Reset), &QPushButton::clicked, this, [edits, apply]()
+    {
+        for (QDoubleSpinBox *edit : edits)
+        {
+            edit -> blockSignals(true);
+            edit -> setValue(0);
+            edit -> blockSignals(false);
+        }
+        apply();
+    });
+    connect(buttonBox, &QDialogButtonBox::rejected, d, &QDialog::reject);
+    return d;
+}
+
+void MainWindow::SaveScene()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Сохранить сцену", QString(), "Сцена (*.l6scene)");
+    if (path.isEmpty())
+    {
+        return;
+    }
+    SceneFile::View view;
+    view.transform = area -> GetAccumulatedTransform();
+    view.projection = area -> GetProjection();
+    view.focalLength = area -> GetFocalLength();
+    view.nearDistance = area -> GetNearDistance();
+    area -> GetRotation(view.angleX, view.angleY, view.angleZ);
+    view.unit = area -> getUnit();
+    view.stripOrdered = true;
+    QString error;
+    if (!SceneFile::Save(path, area -> GetMesh(), view, &error))
+    {
+        QMessageBox::warning(this, "Ошибка", error);
+    }
+}
+
+void MainWindow::OpenScene()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Открыть сцену", QString(), "Сцена (*.l6scene)");
+    if (path.isEmpty())
+    {
+        return;
+    }
+    Mesh mesh;
+    SceneFile::View view;
+    QString error;
+    if (!SceneFile::Load(path, mesh, view, &error))
+    {
+        QMessageBox::warning(this, "Ошибка", error);
+        return;
+    }
+    area -> SetMesh(mesh, view.stripOrdered);
+    // A scan saved without edges can only be shown as points.
+    PointCloudButton -> setChecked(mesh.GetEdgeCount() == 0 || PointCloudButton -> isChecked());
+    area -> ResetTransform();
+    area -> TransformFigure(view.transform);
+    area -> SetPerspective(view.focalLength, view.nearDistance);
+    area -> SetProjection(view.projection);
+    FocalLength -> blockSignals(true);
+    FocalLength -> setValue(view.focalLength);
+    FocalLength -> blockSignals(false);
+    area -> SetRotation(view.angleX, view.angleY, view.angleZ);
+    area -> SetUnit(view.unit);
+    UpdateTransformationMatrix();
+    area -> repaint();
+}
+
+void MainWindow::AttachStream()
+{
+    bool ok;
+    QString key = QInputDialog::getText(this, "Подключить поток", "Ключ разделяемой памяти:", QLineEdit::Normal,
+                                        Stream::DefaultKey, &ok);
+    if (!ok || key.isEmpty())
+    {
+        return;
+    }
+    QString error;
+    if (!area -> AttachStream(key, &error))
+    {
+        QMessageBox::warning(this, "Ошибка", error);
+        return;
+    }
+    area -> FitToView();
+    area -> repaint();
+}
+
+void MainWindow::DetachStream()
+{
+    area -> DetachStream();
+    StreamStats -> clear();
+}
+
+void MainWindow::DumpTrace()
+{
+    QString error;
+    if (!Trace::Dump(QString(), &error))
+    {
+        QMessageBox::warning(this, "Ошибка", error);
+        return;
+    }
+    statusBar() -> showMessage("Трассировка записана в " + Trace::GetPath());
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event -> type() == QEvent::MouseButtonPress || event -> type() == QEvent::Wheel
+        || event -> type() == QEvent::KeyPress)
+    {
+        actionStart = AllocationCounter::GetCounts();
+        actionPeakGeometry = 0;
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::updateAllocationStats()
+{
+    using Subsystem = AllocationCounter::Subsystem;
+    AllocationCounter::Counts const& frame = area -> GetRenderer().GetFrameAllocations();
+    AllocationCounter::Counts action = AllocationCounter::GetCounts() - actionStart;
+    size_t geometry = area -> GetRenderer().GetGeometryBytes();
+    actionPeakGeometry = std::max(actionPeakGeometry, geometry);
+    auto part = [&frame](Subsystem subsystem)
+    {
+        return frame.allocations[static_cast<int>(subsystem)];
+    };
+    AllocationStats -> setText(QString("кадр: %1 выд. (матрицы %2, геометрия %3, QPainter %4), %5 КБ;"
+                                       " действие: %6 выд., %7 КБ; геометрия %8 КБ (пик %9 КБ)")
+                               .arg(frame.GetAllocations())
+                               .arg(part(Subsystem::Matrix))
+                               .arg(part(Subsystem::Geometry))
+                               .arg(part(Subsystem::Painter))
+                               .arg(frame.GetBytes() / 1024)
+                               .arg(action.GetAllocations())
+                               .arg(action.GetBytes() / 1024)
+                               .arg(geometry / 1024)
+                               .arg(actionPeakGeometry / 1024));
+}
@@ -4,6 +4,12 @@
 #include <QMainWindow>
 #include "plotarea.h"
 #include "matrix.h"
+#include "animation.h"
+#include "allocationcounter.h"
+#include <QPushButton>
+#include <QLabel>
+#include <QDoubleSpinBox>
+#include <QDialog>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -44,10 +50,64 @@ private slots:
 
     void on_RevertProjection_clicked();
 
+    void ProjectPerspective();
+
+    void ProjectCavalier();
+
+    void ProjectCabinet();
+
+    void ChangeFocalLength(double value);
+
+    void ToggleAnimation(bool checked);
+
+    void ToggleMultiView(bool checked);
+
+    void TogglePointCloud(bool checked);
+
+    void FitToView();
+
+    void ShowDeformDialog();
+
+    void SaveScene();
+
+    void OpenScene();
+
+    void AttachStream();
+
+    void DetachStream();
+
+    void DumpTrace();
+
 private:
     Ui::MainWindow *ui;
     PlotArea *area = nullptr;
+    Animation *animation = nullptr;
+    QPushButton *AnimationButton = nullptr;
+    QPushButton *MultiViewButton = nullptr;
+    QPushButton *PointCloudButton = nullptr;
+    QLabel *AnimationStats = nullptr;
+    QLabel *RenderStats = nullptr;
+    QLabel *AllocationStats = nullptr;
+    QLabel *StreamStats = nullptr;
+    QPushButton *PerspectiveButton = nullptr;
+    QPushButton *CavalierButton = nullptr;
+    QPushButton *CabinetButton = nullptr;
+    QPushButton *FitButton = nullptr;
+    QPushButton *DeformButton = nullptr;
+    QDoubleSpinBox *FocalLength = nullptr;
+    QDialog *ScaleDialog = nullptr;
+    QDialog *TranslateDialog = nullptr;
+    QDialog *DeformDialog = nullptr;
     double rotationAngle = 0.15;
+    // A user action runs from one press, wheel turn or key press to the next.
+    AllocationCounter::Counts actionStart;
+    size_t actionPeakGeometry = 0;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void updateAllocationStats();
     void UpdateTransformationMatrix();
+    QDialog *createTransformDialog(QString const& title, QString const& prompt, double value, double limit,
+                                   Matrix (*factory)(double, double, double));
+    void showTransformDialog(QDialog *dialog, QDialog *other);
+    QDialog *createDeformDialog();
 };
 #endif // MAINWINDOW_H
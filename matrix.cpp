@@ -1,5 +1,9 @@
 #include "matrix.h"
 #include <cmath>
+#include <QtMath>
+#include <algorithm>
+#include "trace.h"
+#include "allocationcounter.h"
 
 Point::Point(double x, double y, double z, double w)
 {
@@ -44,20 +48,169 @@ Matrix Matrix::operator=(Matrix const& other)
     }
     return *this;
 }
-Matrix Matrix::operator*(Matrix const& other) const
+namespace
+{
+// Block sizes for the packed multiply: a KC x NC panel of B (transposed) is
+// sized to stay in L2, and MC rows of A are streamed against it.
+const int MC = 64;
+const int NC = 128;
+const int KC = 256;
+const int MR = 4;
+const int NR = 4;
+
+// C[r][s] += sum_k A[r][k] * Bt[s][k] for an MR x NR tile. Both operands are
+// read along contiguous k, so the inner loop vectorizes without gathers.
+template <int R, int S>
+inline void microKernel(double const* const* a, int k0, double const* bt, int kn, double** c, int j0)
+{
+    double acc[R][S] = {};
+    for (int k = 0; k < kn; ++k)
+    {
+        for (int r = 0; r < R; ++r)
+        {
+            double ark = a[r][k0 + k];
+            for (int s = 0; s < S; ++s)
+            {
+                acc[r][s] += ark * bt[s * kn + k];
+            }
+        }
+    }
+    for (int r = 0; r < R; ++r)
+    {
+        for (int s = 0; s < S; ++s)
+        {
+            c[r][j0 + s] += acc[r][s];
+        }
+    }
+}
+
+inline void edgeKernel(double const* const* a, int k0, double const* bt, int kn, double** c, int j0, int rows, int cols)
+{
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int s = 0; s < cols; ++s)
+        {
+            double sum = 0;
+            for (int k = 0; k < kn; ++k)
+            {
+                sum += a[r][k0 + k] * bt[s * kn + k];
+            }
+            c[r][j0 + s] += sum;
+        }
+    }
+}
+
+void multiplyBlocked(double const* const* a, double const* const* b, double** c, int n, int m, int p)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Matrix);
+    std::vector<double> packed(static_cast<size_t>(KC) * NC);
+    for (int jj = 0; jj < p; jj += NC)
+    {
+        int jn = std::min(NC, p - jj);
+        for (int kk = 0; kk < m; kk += KC)
+        {
+            int kn = std::min(KC, m - kk);
+            for (int j = 0; j < jn; ++j)
+            {
+                for (int k = 0; k < kn; ++k)
+                {
+                    packed[j * kn + k] = b[kk + k][jj + j];
+                }
+            }
+            for (int ii = 0; ii < n; ii += MC)
+            {
+                int in = std::min(MC, n - ii);
+                for (int i = 0; i < in; i += MR)
+                {
+                    int rows = std::min(MR, in - i);
+                    double const* const* ai = a + ii + i;
+                    double** ci = c + ii + i;
+                    for (int j = 0; j < jn; j += NR)
+                    {
+                        int cols = std::min(NR, jn - j);
+                        if (rows == MR && cols == NR)
+                        {
+                            microKernel<MR, NR>(ai, kk, packed.data() + j * kn, kn, ci, jj + j);
+                        }
+                        else
+                        {
+                            edgeKernel(ai, kk, packed.data() + j * kn, kn, ci, jj + j, rows, cols);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Widens a stored vertex to double and applies a 4x4 transform with w = 1,
+// so the fourth column is added instead of multiplied.
+template <typename Vertex>
+void transformImplicitW(double const* const* a, const Vertex* vertices, size_t count, Point* out)
+{
+    double const* r0 = a[0];
+    double const* r1 = a[1];
+    double const* r2 = a[2];
+    double const* r3 = a[3];
+    for (size_t i = 0; i < count; ++i)
+    {
+        double x = vertices[i].x;
+        double y = vertices[i].y;
+        double z = vertices[i].z;
+        out[i] = Point(r0[0] * x + r0[1] * y + r0[2] * z + r0[3],
+                       r1[0] * x + r1[1] * y + r1[2] * z + r1[3],
+                       r2[0] * x + r2[1] * y + r2[2] * z + r2[3],
+                       r3[0] * x + r3[1] * y + r3[2] * z + r3[3]);
+    }
+}
+
+template <typename Vertex>
+void projectImplicitW(double const* const* a, const Vertex* vertices, size_t count, QPointF* out)
+{
+    double const* r0 = a[0];
+    double const* r1 = a[1];
+    for (size_t i = 0; i < count; ++i)
+    {
+        double x = vertices[i].x;
+        double y = vertices[i].y;
+        double z = vertices[i].z;
+        out[i] = QPointF(r0[0] * x + r0[1] * y + r0[2] * z + r0[3],
+                         r1[0] * x + r1[1] * y + r1[2] * z + r1[3]);
+    }
+}
+
+// With a short inner dimension (4x4 transforms, 4x4 * 4xN point matrices)
+// packing costs as much as the product itself, so stream rows of B instead.
+void multiplyStreaming(double const* const* a, double const* const* b, double** c, int n, int m, int p)
 {
-    assert(m == other.n);
-    Matrix res(n, other.m);
     for (int i = 0; i < n; ++i)
     {
-        for (int j = 0; j < other.m; ++j)
+        double* ci = c[i];
+        for (int k = 0; k < m; ++k)
         {
-            for (int k = 0; k < m; ++k)
+            double aik = a[i][k];
+            double const* bk = b[k];
+            for (int j = 0; j < p; ++j)
             {
-                res.array[i][j] += array[i][k] * other.array[k][j];
+                ci[j] += aik * bk[j];
             }
         }
     }
+}
+}
+
+Matrix Matrix::operator*(Matrix const& other) const
+{
+    assert(m == other.n);
+    Matrix res(n, other.m);
+    if (m <= 8)
+    {
+        multiplyStreaming(array, other.array, res.array, n, m, other.m);
+    }
+    else
+    {
+        multiplyBlocked(array, other.array, res.array, n, m, other.m);
+    }
     return res;
 }
 
@@ -73,6 +226,61 @@ Matrix Matrix::transpose() const
     }
     return res;
 }
+Matrix Matrix::inverse(bool* ok) const
+{
+    assert(n == m);
+    Matrix a(*this);
+    Matrix res(n, n);
+    for (int i = 0; i < n; ++i)
+    {
+        res.array[i][i] = 1;
+    }
+    for (int col = 0; col < n; ++col)
+    {
+        int pivot = col;
+        for (int i = col + 1; i < n; ++i)
+        {
+            if (std::abs(a.array[i][col]) > std::abs(a.array[pivot][col]))
+            {
+                pivot = i;
+            }
+        }
+        if (std::abs(a.array[pivot][col]) < 1e-12)
+        {
+            if (ok)
+            {
+                *ok = false;
+            }
+            return GetIdentityMatrix();
+        }
+        std::swap(a.array[pivot], a.array[col]);
+        std::swap(res.array[pivot], res.array[col]);
+        double scale = 1 / a.array[col][col];
+        for (int j = 0; j < n; ++j)
+        {
+            a.array[col][j] *= scale;
+            res.array[col][j] *= scale;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            if (i != col && a.array[i][col] != 0)
+            {
+                double factor = a.array[i][col];
+                for (int j = 0; j < n; ++j)
+                {
+                    a.array[i][j] -= factor * a.array[col][j];
+                    res.array[i][j] -= factor * res.array[col][j];
+                }
+            }
+        }
+    }
+    if (ok)
+    {
+        *ok = true;
+    }
+    return res;
+}
+
 Matrix Matrix::GetProjectionMatrix(ProjectionType type)
 {
     Matrix res(4, 4);
@@ -89,10 +297,36 @@ Matrix Matrix::GetProjectionMatrix(ProjectionType type)
     case ProjectionType::ProjectionOYZ:
         res.array[1][1] = 1;
         res.array[2][2] = 1;
+        break;
+    case ProjectionType::ProjectionPerspective:
+        return GetPerspectiveMatrix(15);
+    case ProjectionType::ProjectionCavalier:
+        return GetObliqueMatrix(1, M_PI / 4);
+    case ProjectionType::ProjectionCabinet:
+        return GetObliqueMatrix(0.5, M_PI / 4);
     }
     res.array[3][3] = 1;
     return res;
 }
+Matrix Matrix::GetPerspectiveMatrix(double focalLength)
+{
+    Matrix res(4, 4);
+    res.array[0][0] = 1;
+    res.array[1][1] = 1;
+    res.array[3][2] = -1 / focalLength;
+    res.array[3][3] = 1;
+    return res;
+}
+Matrix Matrix::GetObliqueMatrix(double depthScale, double angle)
+{
+    Matrix res(4, 4);
+    res.array[0][0] = 1;
+    res.array[1][1] = 1;
+    res.array[0][2] = depthScale * cos(angle);
+    res.array[1][2] = depthScale * sin(angle);
+    res.array[3][3] = 1;
+    return res;
+}
 Matrix Matrix::GetScaleMatrix(double scaleX, double scaleY, double scaleZ)
 {
     Matrix res(4, 4);
@@ -133,6 +367,23 @@ Matrix Matrix::GetRotationMatrix(RotationType type, double angle)
     res.array[3][3] = 1;
     return res;
 }
+Matrix Matrix::GetRotationMatrix(QQuaternion const& rotation)
+{
+    QQuaternion q = rotation.normalized();
+    double w = q.scalar(), x = q.x(), y = q.y(), z = q.z();
+    Matrix res(4, 4);
+    res.array[0][0] = 1 - 2 * (y * y + z * z);
+    res.array[0][1] = 2 * (x * y - w * z);
+    res.array[0][2] = 2 * (x * z + w * y);
+    res.array[1][0] = 2 * (x * y + w * z);
+    res.array[1][1] = 1 - 2 * (x * x + z * z);
+    res.array[1][2] = 2 * (y * z - w * x);
+    res.array[2][0] = 2 * (x * z - w * y);
+    res.array[2][1] = 2 * (y * z + w * x);
+    res.array[2][2] = 1 - 2 * (x * x + y * y);
+    res.array[3][3] = 1;
+    return res;
+}
 Matrix Matrix::GetAksonometricMatrix(double angleX, double angleY, double angleZ)
 {
     Matrix res(4, 4);
@@ -173,9 +424,13 @@ Matrix Matrix::GetTranslationMatrix(double translateX, double translateY, double
     return res;
 }
 Matrix Matrix::ComposeFromPoints(std::vector<Point> const& points)
+{
+    return ComposeFromPoints(points.data(), points.size());
+}
+Matrix Matrix::ComposeFromPoints(const Point* points, size_t count)
 {
     int n = 4;
-    int m = points.size();
+    int m = count;
     Matrix res(n, m);
     for (int i = 0; i < n; ++i)
     {
@@ -186,8 +441,21 @@ Matrix Matrix::ComposeFromPoints(std::vector<Point> const& points)
     }
     return res;
 }
+Matrix Matrix::FromValues(int n, int m, const double* values)
+{
+    Matrix res(n, m);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < m; ++j)
+        {
+            res.array[i][j] = values[i * m + j];
+        }
+    }
+    return res;
+}
 std::vector<Point> Matrix::DecomposeToPoints(Matrix const& matr)
 {
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Matrix);
     std::vector<Point> ans;
     for (int i = 0; i < matr.m; ++i)
     {
@@ -195,6 +463,79 @@ std::vector<Point> Matrix::DecomposeToPoints(Matrix const& matr)
     }
     return ans;
 }
+std::vector<Matrix> Matrix::ComposeBatch(Matrix const& view, std::vector<Matrix> const& transforms)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Matrix);
+    std::vector<Matrix> res(transforms.size(), Matrix(4, 4));
+    ComposeBatch(view, transforms.data(), transforms.size(), res.data());
+    return res;
+}
+void Matrix::ComposeBatch(Matrix const& view, const Matrix* transforms, size_t count, Matrix* out)
+{
+    TRACE_SCOPE("transform", "ComposeBatch");
+    assert(view.n == 4 && view.m == 4);
+    double const* const* a = view.array;
+    for (size_t t = 0; t < count; ++t)
+    {
+        assert(transforms[t].n == 4 && transforms[t].m == 4 && out[t].n == 4 && out[t].m == 4);
+        double const* const* b = transforms[t].array;
+        double** c = out[t].array;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                c[i][j] = 0;
+            }
+            for (int k = 0; k < 4; ++k)
+            {
+                double aik = a[i][k];
+                for (int j = 0; j < 4; ++j)
+                {
+                    c[i][j] += aik * b[k][j];
+                }
+            }
+        }
+    }
+}
+void Matrix::TransformPoints(const Point* points, size_t count, Point* out) const
+{
+    assert(n == 4 && m == 4);
+    double const* r0 = array[0];
+    double const* r1 = array[1];
+    double const* r2 = array[2];
+    double const* r3 = array[3];
+    for (size_t i = 0; i < count; ++i)
+    {
+        double x = points[i].getParameter(0);
+        double y = points[i].getParameter(1);
+        double z = points[i].getParameter(2);
+        double w = points[i].getParameter(3);
+        out[i] = Point(r0[0] * x + r0[1] * y + r0[2] * z + r0[3] * w,
+                       r1[0] * x + r1[1] * y + r1[2] * z + r1[3] * w,
+                       r2[0] * x + r2[1] * y + r2[2] * z + r2[3] * w,
+                       r3[0] * x + r3[1] * y + r3[2] * z + r3[3] * w);
+    }
+}
+void Matrix::TransformPoints(const PackedVertex* vertices, size_t count, Point* out) const
+{
+    assert(n == 4 && m == 4);
+    transformImplicitW(array, vertices, count, out);
+}
+void Matrix::TransformPoints(const QuantizedVertex* vertices, size_t count, Point* out) const
+{
+    assert(n == 4 && m == 4);
+    transformImplicitW(array, vertices, count, out);
+}
+void Matrix::ProjectPoints(const PackedVertex* vertices, size_t count, QPointF* out) const
+{
+    assert(n == 2 && m == 4);
+    projectImplicitW(array, vertices, count, out);
+}
+void Matrix::ProjectPoints(const QuantizedVertex* vertices, size_t count, QPointF* out) const
+{
+    assert(n == 2 && m == 4);
+    projectImplicitW(array, vertices, count, out);
+}
 
 QString Matrix::ToQString() const
 {
@@ -221,40 +562,50 @@ QString Matrix::ToQString() const
     return ans;
 }
 
+double Matrix::getElement(int i, int j) const
+{
+    return array[i][j];
+}
 
 void Matrix::AllocateMemory(int _n, int _m)
 {
     n = _n;
     m = _m;
-    array = new double*[n];
-    for (int i = 0; i < n; ++i)
+    if (n <= 4 && n * m <= 16)
     {
-        array[i] = new double[m];
+        storage = inlineStorage;
+        array = inlineRows;
+        std::fill(storage, storage + n * m, 0.0);
+    }
+    else
+    {
+        AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Matrix);
+        storage = new double[static_cast<size_t>(n) * m]();
+        array = new double*[n];
     }
     for (int i = 0; i < n; ++i)
     {
-        for (int j = 0; j < m; ++j)
-        {
-            array[i][j] = 0;
-        }
+        array[i] = storage + static_cast<size_t>(i) * m;
     }
 }
 void Matrix::FreeMemory()
 {
-    for (int i = 0; i < n; ++i)
+    if (storage != inlineStorage)
     {
-        delete[] array[i];
+        delete[] storage;
     }
-    delete[] array;
+    if (array != inlineRows)
+    {
+        delete[] array;
+    }
+    storage = nullptr;
+    array = nullptr;
 }
 void Matrix::CopyValues(Matrix const& other)
 {
     for (int i = 0; i < other.n; ++i)
     {
-        for (int j = 0; j < other.m; ++j)
-        {
-            array[i][j] = other.array[i][j];
-        }
+        std::copy(other.array[i], other.array[i] + other.m, array[i]);
     }
 }
 Matrix::~Matrix()
@@ -5,6 +5,7 @@
 #include <iomanip>
 #include <QPointF>
 #include <QString>
+#include <QQuaternion>
 
 class Point
 {
@@ -18,6 +19,19 @@ private:
 };
 
 
+// Stored vertex formats. Every stored vertex has w = 1, so it is left out
+// and only restored inside the transform kernels.
+struct PackedVertex
+{
+    float x, y, z;
+};
+
+struct QuantizedVertex
+{
+    quint16 x, y, z;
+};
+
+
 class Matrix
 {
 public:
@@ -26,6 +40,9 @@ public:
         ProjectionOXY,
         ProjectionOXZ,
         ProjectionOYZ,
+        ProjectionPerspective,
+        ProjectionCavalier,
+        ProjectionCabinet,
     };
     enum class RotationType
     {
@@ -34,20 +51,36 @@ public:
         RotationOZ,
     };
     static Matrix GetProjectionMatrix(ProjectionType type);
+    static Matrix GetPerspectiveMatrix(double focalLength);
+    static Matrix GetObliqueMatrix(double depthScale, double angle);
     static Matrix GetAksonometricMatrix(double angleX, double angleY, double angleZ);
     static Matrix GetScaleMatrix(double scaleX, double scaleY, double scaleZ);
     static Matrix GetRotationMatrix(RotationType type, double angle);
+    static Matrix GetRotationMatrix(QQuaternion const& rotation);
     static Matrix GetTranslationMatrix(double translateX, double translateY, double translateZ);
     static Matrix GetIdentityMatrix();
     static Matrix ComposeFromPoints(std::vector<Point> const& points);
+    static Matrix ComposeFromPoints(const Point* points, size_t count);
+    static Matrix FromValues(int n, int m, const double* values);
     static std::vector<Point> DecomposeToPoints(Matrix const& matr);
+    static std::vector<Matrix> ComposeBatch(Matrix const& view, std::vector<Matrix> const& transforms);
+    static void ComposeBatch(Matrix const& view, const Matrix* transforms, size_t count, Matrix* out);
 
     QString ToQString() const;
+    double getElement(int i, int j) const;
 
     Matrix operator=(Matrix const& other);
     Matrix operator*(Matrix const& other) const;
 
     Matrix transpose() const;
+    Matrix inverse(bool* ok = nullptr) const;
+    void TransformPoints(const Point* points, size_t count, Point* out) const;
+    void TransformPoints(const PackedVertex* vertices, size_t count, Point* out) const;
+    void TransformPoints(const QuantizedVertex* vertices, size_t count, Point* out) const;
+    // For a 2x4 matrix that maps a stored vertex straight to device
+    // coordinates: one fused pass with no intermediate Point.
+    void ProjectPoints(const PackedVertex* vertices, size_t count, QPointF* out) const;
+    void ProjectPoints(const QuantizedVertex* vertices, size_t count, QPointF* out) const;
 
     Matrix(Matrix const& other);
 
@@ -57,7 +90,13 @@ private:
     void FreeMemory();
     void AllocateMemory(int n, int m);
     void CopyValues(Matrix const& other);
+    // Rows are slices of one contiguous row-major block; row pointers may be
+    // permuted (see inverse), but each row is always contiguous. Matrices of
+    // up to 4x4 keep the block inline so transforms never touch the heap.
+    double *storage = nullptr;
     double **array = nullptr;
+    double inlineStorage[16];
+    double *inlineRows[4];
     int n = 0, m = 0;
 };
 
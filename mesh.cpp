@@ -0,0 +1,749 @@
+#include "mesh.h"
+#include "allocationcounter.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESH_SSE2
+#endif
+
+namespace
+{
+struct OwnedVertices
+{
+    std::vector<PackedVertex> packed;
+    std::vector<QuantizedVertex> quantized;
+    Mesh::Quantization quantization;
+    std::shared_ptr<const void> edges;
+
+    const void* Data() const
+    {
+        return packed.empty() ? static_cast<const void*>(quantized.data()) : packed.data();
+    }
+};
+
+struct OwnedData : OwnedVertices
+{
+    std::vector<Edge> edgeList;
+};
+
+struct OwnedEdges
+{
+    std::vector<Edge> edgeList;
+    std::shared_ptr<const void> vertices;
+};
+
+// Orders edges into the fewest trails: odd-degree vertices are paired with
+// virtual edges, Hierholzer's algorithm walks an Euler circuit of every
+// component, and the circuits are cut at the virtual edges. A component
+// with 2k odd vertices becomes k trails, one without becomes one closed
+// trail, which is the minimum for any edge set.
+// Every edge must index one of vertexCount vertices, and vertices and edges
+// (with up to vertexCount / 2 virtual ones) must fit in 32-bit indices;
+// ToStrips checks the sizes, files and streams check the indices on load.
+std::vector<Edge> stripOrder(const Edge* edges, size_t edgeCount, size_t vertexCount)
+{
+    std::vector<int> degree(vertexCount, 0);
+    for (size_t i = 0; i < edgeCount; ++i)
+    {
+        assert(edges[i].a >= 0 && size_t(edges[i].a) < vertexCount && edges[i].b >= 0 && size_t(edges[i].b) < vertexCount);
+        degree[edges[i].a]++;
+        degree[edges[i].b]++;
+    }
+    std::vector<Edge> all(edges, edges + edgeCount);
+    int pending = -1;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (degree[v] % 2 == 0)
+        {
+            continue;
+        }
+        if (pending < 0)
+        {
+            pending = static_cast<int>(v);
+            continue;
+        }
+        all.push_back({pending, static_cast<qint32>(v)});
+        pending = -1;
+    }
+
+    // Adjacency in CSR form; every edge appears once from each end.
+    std::vector<size_t> first(vertexCount + 1, 0);
+    for (Edge const& e : all)
+    {
+        first[e.a + 1]++;
+        first[e.b + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        first[v + 1] += first[v];
+    }
+    std::vector<size_t> next(first.begin(), first.end() - 1);
+    std::vector<qint32> incident(first.back());
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        incident[next[all[i].a]++] = static_cast<qint32>(i);
+        incident[next[all[i].b]++] = static_cast<qint32>(i);
+    }
+    std::copy(first.begin(), first.end() - 1, next.begin());
+
+    struct Step
+    {
+        qint32 vertex;
+        qint32 edge;
+    };
+    std::vector<char> used(all.size(), 0);
+    std::vector<Step> stack;
+    std::vector<Step> circuit;
+    std::vector<Edge> res;
+    res.reserve(edgeCount);
+    for (size_t start = 0; start < vertexCount; ++start)
+    {
+        if (next[start] == first[start + 1])
+        {
+            continue;
+        }
+        circuit.clear();
+        stack.push_back({static_cast<qint32>(start), -1});
+        while (!stack.empty())
+        {
+            qint32 v = stack.back().vertex;
+            size_t& cursor = next[v];
+            while (cursor < first[v + 1] && used[incident[cursor]])
+            {
+                ++cursor;
+            }
+            if (cursor == first[v + 1])
+            {
+                circuit.push_back(stack.back());
+                stack.pop_back();
+                continue;
+            }
+            qint32 e = incident[cursor++];
+            used[e] = 1;
+            stack.push_back({all[e].a == v ? all[e].b : all[e].a, e});
+        }
+        // circuit holds the walk backwards: each step is the vertex reached
+        // and the edge taken to reach it. Start after a virtual edge so that
+        // no trail wraps around the end.
+        if (circuit.size() < 2)
+        {
+            continue;
+        }
+        std::reverse(circuit.begin(), circuit.end());
+        size_t steps = circuit.size() - 1;
+        size_t offset = 0;
+        for (size_t i = 1; i < circuit.size(); ++i)
+        {
+            if (static_cast<size_t>(circuit[i].edge) >= edgeCount)
+            {
+                offset = i;
+                break;
+            }
+        }
+        for (size_t k = 0; k < steps; ++k)
+        {
+            size_t i = 1 + (offset + k) % steps;
+            if (static_cast<size_t>(circuit[i].edge) < edgeCount)
+            {
+                res.push_back({circuit[i - 1].vertex, circuit[i].vertex});
+            }
+        }
+    }
+    return res;
+}
+
+// The offset that takes the front half of every contour onto its back half,
+// if one offset does it for all of them.
+bool commonOffset(std::vector<std::vector<Point>> const& contours, double offset[3])
+{
+    bool found = false;
+    for (std::vector<Point> const& contour : contours)
+    {
+        size_t shift = contour.size() / 2;
+        if (contour.size() % 2 != 0)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < shift; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                double delta = contour[shift + i].getParameter(k) - contour[i].getParameter(k);
+                if (!found)
+                {
+                    offset[k] = delta;
+                }
+                else if (std::abs(delta - offset[k]) > 1e-9 * (1 + std::abs(offset[k])))
+                {
+                    return false;
+                }
+            }
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Fills the back half of an extrusion: every transform is linear on
+// homogeneous points, so M(p + d) = Mp + Md for a direction d (w = 0), and
+// each back vertex costs one add instead of another product.
+void appendMoved(Point* points, size_t count, Point const& moved)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        Point const& p = points[i];
+        points[count + i] = Point(p.getParameter(0) + moved.getParameter(0), p.getParameter(1) + moved.getParameter(1),
+                                  p.getParameter(2) + moved.getParameter(2), p.getParameter(3) + moved.getParameter(3));
+    }
+}
+
+void appendMoved(QPointF* points, size_t count, QPointF moved)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        points[count + i] = points[i] + moved;
+    }
+}
+
+// Component-wise min and max of count vertices stored as a flat run of
+// coordinates. Vector lanes cycle through x, y and z, so four float
+// (eight 16-bit) vertices fill exactly three registers; the lanes are folded
+// per coordinate at the end.
+void floatBounds(const float* values, size_t count, float lo[3], float hi[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        lo[k] = hi[k] = values[k];
+    }
+    size_t i = 0;
+#ifdef MESH_SSE2
+    if (count >= 4)
+    {
+        __m128 mn[3], mx[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            mn[r] = mx[r] = _mm_loadu_ps(values + 4 * r);
+        }
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                __m128 v = _mm_loadu_ps(values + 3 * i + 4 * r);
+                mn[r] = _mm_min_ps(mn[r], v);
+                mx[r] = _mm_max_ps(mx[r], v);
+            }
+        }
+        float lanesLo[12], lanesHi[12];
+        for (int r = 0; r < 3; ++r)
+        {
+            _mm_storeu_ps(lanesLo + 4 * r, mn[r]);
+            _mm_storeu_ps(lanesHi + 4 * r, mx[r]);
+        }
+        for (int l = 0; l < 12; ++l)
+        {
+            lo[l % 3] = std::min(lo[l % 3], lanesLo[l]);
+            hi[l % 3] = std::max(hi[l % 3], lanesHi[l]);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::min(lo[k], values[3 * i + k]);
+            hi[k] = std::max(hi[k], values[3 * i + k]);
+        }
+    }
+}
+
+void quantizedBounds(const quint16* values, size_t count, quint16 lo[3], quint16 hi[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        lo[k] = hi[k] = values[k];
+    }
+    size_t i = 0;
+#ifdef MESH_SSE2
+    if (count >= 8)
+    {
+        // SSE2 only compares signed 16-bit values; flipping the top bit
+        // maps the unsigned order onto the signed one.
+        const __m128i bias = _mm_set1_epi16(-0x8000);
+        __m128i mn[3], mx[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            mn[r] = mx[r] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + 8 * r)), bias);
+        }
+        for (i = 8; i + 8 <= count; i += 8)
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + 3 * i + 8 * r)), bias);
+                mn[r] = _mm_min_epi16(mn[r], v);
+                mx[r] = _mm_max_epi16(mx[r], v);
+            }
+        }
+        quint16 lanesLo[24], lanesHi[24];
+        for (int r = 0; r < 3; ++r)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesLo + 8 * r), _mm_xor_si128(mn[r], bias));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesHi + 8 * r), _mm_xor_si128(mx[r], bias));
+        }
+        for (int l = 0; l < 24; ++l)
+        {
+            lo[l % 3] = std::min(lo[l % 3], lanesLo[l]);
+            hi[l % 3] = std::max(hi[l % 3], lanesHi[l]);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::min(lo[k], values[3 * i + k]);
+            hi[k] = std::max(hi[k], values[3 * i + k]);
+        }
+    }
+}
+
+void packVertices(std::vector<Point> const& vertices, Mesh::VertexFormat format, OwnedVertices& data)
+{
+    if (format == Mesh::VertexFormat::Float)
+    {
+        data.packed.reserve(vertices.size());
+        for (const Point& p : vertices)
+        {
+            data.packed.push_back({float(p.getParameter(0)), float(p.getParameter(1)), float(p.getParameter(2))});
+        }
+        return;
+    }
+    double lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            double v = vertices[i].getParameter(k);
+            lo[k] = i == 0 ? v : std::min(lo[k], v);
+            hi[k] = i == 0 ? v : std::max(hi[k], v);
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        data.quantization.offset[k] = lo[k];
+        data.quantization.scale[k] = hi[k] > lo[k] ? (hi[k] - lo[k]) / 65535 : 1;
+    }
+    data.quantized.reserve(vertices.size());
+    for (const Point& p : vertices)
+    {
+        quint16 q[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            double scaled = (p.getParameter(k) - data.quantization.offset[k]) / data.quantization.scale[k];
+            q[k] = quint16(std::clamp(std::lround(scaled), 0L, 65535L));
+        }
+        data.quantized.push_back({q[0], q[1], q[2]});
+    }
+}
+}
+
+Mesh Mesh::FromContours(std::vector<std::vector<Point>> const& contours)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    double offset[3];
+    if (commonOffset(contours, offset))
+    {
+        std::vector<std::vector<Point>> profiles;
+        for (std::vector<Point> const& contour : contours)
+        {
+            profiles.emplace_back(contour.begin(), contour.begin() + contour.size() / 2);
+        }
+        return Extrusion(profiles, Point(offset[0], offset[1], offset[2], 0));
+    }
+    std::vector<Point> vertices;
+    std::vector<Edge> edges;
+    for (std::vector<Point> const& contour : contours)
+    {
+        int first = vertices.size();
+        int shift = contour.size() / 2;
+        vertices.insert(vertices.end(), contour.begin(), contour.end());
+        for (int i = 0; i + 1 < shift; ++i)
+        {
+            edges.push_back({first + i, first + i + 1});
+        }
+        for (int i = 0; i + 1 < shift; ++i)
+        {
+            edges.push_back({first + shift + i, first + shift + i + 1});
+        }
+        for (int i = 0; i < shift; ++i)
+        {
+            edges.push_back({first + i, first + shift + i});
+        }
+    }
+    return FromData(std::move(vertices), std::move(edges));
+}
+
+// Edges laid out the way FromContours lays them out, with the back copy of
+// every profile after all the profiles.
+Mesh Mesh::Extrusion(std::vector<std::vector<Point>> const& profiles, Point const& offset, VertexFormat format)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    std::vector<Point> vertices;
+    for (std::vector<Point> const& profile : profiles)
+    {
+        vertices.insert(vertices.end(), profile.begin(), profile.end());
+    }
+    int back = vertices.size();
+    std::vector<Edge> edges;
+    int first = 0;
+    for (std::vector<Point> const& profile : profiles)
+    {
+        int count = profile.size();
+        for (int i = 0; i + 1 < count; ++i)
+        {
+            edges.push_back({first + i, first + i + 1});
+        }
+        for (int i = 0; i + 1 < count; ++i)
+        {
+            edges.push_back({back + first + i, back + first + i + 1});
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            edges.push_back({first + i, back + first + i});
+        }
+        first += count;
+    }
+    return FromData(vertices, std::move(edges), format).WithExtrusion(offset);
+}
+
+// Rings of a torus, each closed polyline followed by the segments joining
+// neighbouring rings, so the edge list chains the way contours do.
+Mesh Mesh::Torus(int rings, int segments, VertexFormat format)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    std::vector<Point> vertices;
+    std::vector<Edge> edges;
+    for (int i = 0; i < rings; ++i)
+    {
+        double phi = 2 * M_PI * i / rings;
+        for (int j = 0; j < segments; ++j)
+        {
+            double theta = 2 * M_PI * j / segments;
+            double r = 4 + 1.5 * cos(theta);
+            vertices.push_back(Point(r * cos(phi), 1.5 * sin(theta), r * sin(phi)));
+        }
+    }
+    for (int i = 0; i < rings; ++i)
+    {
+        for (int j = 0; j < segments; ++j)
+        {
+            edges.push_back({i * segments + j, i * segments + (j + 1) % segments});
+        }
+    }
+    for (int i = 0; i < rings; ++i)
+    {
+        for (int j = 0; j < segments; ++j)
+        {
+            edges.push_back({i * segments + j, (i + 1) % rings * segments + j});
+        }
+    }
+    return FromData(vertices, std::move(edges), format);
+}
+
+Mesh Mesh::FromData(std::vector<Point> const& vertices, std::vector<Edge> edges, VertexFormat format)
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto data = std::make_shared<OwnedData>();
+    packVertices(vertices, format, *data);
+    data->edgeList = std::move(edges);
+    return FromBuffers(data->Data(), format, data->quantization, vertices.size(),
+                       data->edgeList.data(), data->edgeList.size(), data);
+}
+
+Mesh Mesh::FromBuffers(const void* vertices, VertexFormat format, Quantization const& quantization, size_t vertexCount,
+                       const Edge* edges, size_t edgeCount, std::shared_ptr<const void> owner)
+{
+    Mesh res;
+    res.storage = std::move(owner);
+    res.vertices = vertices;
+    res.format = format;
+    res.quantization = quantization;
+    res.vertexCount = vertexCount;
+    res.edges = edges;
+    res.edgeCount = edgeCount;
+    res.storedCount = vertexCount;
+    return res;
+}
+
+size_t Mesh::GetVertexSize(VertexFormat format)
+{
+    return format == VertexFormat::Float ? sizeof(PackedVertex) : sizeof(QuantizedVertex);
+}
+
+const void* Mesh::GetVertexData() const
+{
+    return vertices;
+}
+
+size_t Mesh::GetStoredVertexCount() const
+{
+    return storedCount;
+}
+
+bool Mesh::IsExtrusion() const
+{
+    return extruded;
+}
+
+Point Mesh::GetExtrusion() const
+{
+    return extrusion;
+}
+
+Mesh::VertexFormat Mesh::GetVertexFormat() const
+{
+    return format;
+}
+
+Mesh::Quantization const& Mesh::GetQuantization() const
+{
+    return quantization;
+}
+
+Point Mesh::GetVertex(size_t index) const
+{
+    bool back = index >= storedCount;
+    if (back)
+    {
+        index -= storedCount;
+    }
+    double v[3];
+    if (format == VertexFormat::Float)
+    {
+        const PackedVertex& p = static_cast<const PackedVertex*>(vertices)[index];
+        v[0] = p.x;
+        v[1] = p.y;
+        v[2] = p.z;
+    }
+    else
+    {
+        const QuantizedVertex& q = static_cast<const QuantizedVertex*>(vertices)[index];
+        v[0] = q.x * quantization.scale[0] + quantization.offset[0];
+        v[1] = q.y * quantization.scale[1] + quantization.offset[1];
+        v[2] = q.z * quantization.scale[2] + quantization.offset[2];
+    }
+    if (back)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            v[k] += extrusion.getParameter(k);
+        }
+    }
+    return Point(v[0], v[1], v[2]);
+}
+
+bool Mesh::GetBounds(double lo[3], double hi[3]) const
+{
+    if (storedCount == 0)
+    {
+        return false;
+    }
+    if (format == VertexFormat::Float)
+    {
+        static_assert(sizeof(PackedVertex) == 3 * sizeof(float), "PackedVertex is read as a flat float array");
+        float flo[3], fhi[3];
+        floatBounds(reinterpret_cast<const float*>(vertices), storedCount, flo, fhi);
+        std::copy(flo, flo + 3, lo);
+        std::copy(fhi, fhi + 3, hi);
+    }
+    else
+    {
+        static_assert(sizeof(QuantizedVertex) == 3 * sizeof(quint16), "QuantizedVertex is read as a flat 16-bit array");
+        quint16 qlo[3], qhi[3];
+        quantizedBounds(reinterpret_cast<const quint16*>(vertices), storedCount, qlo, qhi);
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = qlo[k] * quantization.scale[k] + quantization.offset[k];
+            hi[k] = qhi[k] * quantization.scale[k] + quantization.offset[k];
+        }
+    }
+    if (extruded)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            double shift = extrusion.getParameter(k);
+            lo[k] = std::min(lo[k], lo[k] + shift);
+            hi[k] = std::max(hi[k], hi[k] + shift);
+        }
+    }
+    return true;
+}
+
+void Mesh::TransformVertices(Matrix const& transform, Point* out) const
+{
+    if (format == VertexFormat::Float)
+    {
+        transform.TransformPoints(static_cast<const PackedVertex*>(vertices), storedCount, out);
+    }
+    else
+    {
+        // Dequantization is folded into the transform, so the kernel only
+        // widens the 16-bit coordinates.
+        Matrix dequantize = Matrix::GetTranslationMatrix(quantization.offset[0], quantization.offset[1], quantization.offset[2])
+            * Matrix::GetScaleMatrix(quantization.scale[0], quantization.scale[1], quantization.scale[2]);
+        (transform * dequantize).TransformPoints(static_cast<const QuantizedVertex*>(vertices), storedCount, out);
+    }
+    if (extruded)
+    {
+        Point moved(0, 0, 0, 0);
+        transform.TransformPoints(&extrusion, 1, &moved);
+        appendMoved(out, storedCount, moved);
+    }
+}
+
+void Mesh::ProjectVertices(Matrix const& screen, QPointF* out) const
+{
+    if (format == VertexFormat::Float)
+    {
+        screen.ProjectPoints(static_cast<const PackedVertex*>(vertices), storedCount, out);
+    }
+    else
+    {
+        Matrix dequantize = Matrix::GetTranslationMatrix(quantization.offset[0], quantization.offset[1], quantization.offset[2])
+            * Matrix::GetScaleMatrix(quantization.scale[0], quantization.scale[1], quantization.scale[2]);
+        (screen * dequantize).ProjectPoints(static_cast<const QuantizedVertex*>(vertices), storedCount, out);
+    }
+    if (extruded)
+    {
+        double moved[2] = {0, 0};
+        for (int r = 0; r < 2; ++r)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                moved[r] += screen.getElement(r, k) * extrusion.getParameter(k);
+            }
+        }
+        appendMoved(out, storedCount, QPointF(moved[0], moved[1]));
+    }
+}
+
+size_t Mesh::GetVertexCount() const
+{
+    return vertexCount;
+}
+
+const Edge* Mesh::GetEdges() const
+{
+    return edges;
+}
+
+size_t Mesh::GetEdgeCount() const
+{
+    return edgeCount;
+}
+
+Mesh Mesh::ToStrips() const
+{
+    // Beyond 32-bit indices the edges are left in their order.
+    const size_t indexLimit = size_t(std::numeric_limits<qint32>::max());
+    if (edgeCount == 0 || vertexCount > indexLimit || edgeCount > indexLimit - vertexCount / 2)
+    {
+        return *this;
+    }
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto data = std::make_shared<OwnedEdges>();
+    data->edgeList = stripOrder(edges, edgeCount, vertexCount);
+    data->vertices = storage;
+    Mesh res = *this;
+    res.storage = data;
+    res.edges = data->edgeList.data();
+    res.edgeCount = data->edgeList.size();
+    return res;
+}
+
+size_t Mesh::CountStrips() const
+{
+    size_t strips = 0;
+    for (size_t i = 0; i < edgeCount; ++i)
+    {
+        strips += i == 0 || edges[i].a != edges[i - 1].b;
+    }
+    return strips;
+}
+
+Mesh Mesh::WithVertices(std::vector<Point> const& newVertices) const
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto data = std::make_shared<OwnedVertices>();
+    packVertices(newVertices, format, *data);
+    data->edges = storage;
+    return FromBuffers(data->Data(), format, data->quantization, newVertices.size(), edges, edgeCount, data);
+}
+
+Mesh Mesh::WithExtrusion(Point const& offset) const
+{
+    Mesh res = *this;
+    res.extruded = true;
+    res.extrusion = Point(offset.getParameter(0), offset.getParameter(1), offset.getParameter(2), 0);
+    res.vertexCount = 2 * storedCount;
+    return res;
+}
+
+Mesh Mesh::Transformed(Matrix const& transform) const
+{
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    auto data = std::make_shared<OwnedVertices>();
+    data->packed.resize(storedCount);
+    data->edges = storage;
+    Matrix full = transform;
+    if (format == VertexFormat::Quantized16)
+    {
+        full = transform * Matrix::GetTranslationMatrix(quantization.offset[0], quantization.offset[1], quantization.offset[2])
+             * Matrix::GetScaleMatrix(quantization.scale[0], quantization.scale[1], quantization.scale[2]);
+    }
+    // Blocks of transformed points are packed as they are produced, so no
+    // full-size double buffer is needed.
+    const size_t blockSize = 1024;
+    Parallel::For(storedCount, blockSize * 16, [&](size_t first, size_t last)
+    {
+        std::vector<Point> block(std::min(blockSize, last - first), Point(0, 0, 0));
+        for (size_t i = first; i < last; i += blockSize)
+        {
+            size_t count = std::min(blockSize, last - i);
+            if (format == VertexFormat::Float)
+            {
+                full.TransformPoints(static_cast<const PackedVertex*>(vertices) + i, count, block.data());
+            }
+            else
+            {
+                full.TransformPoints(static_cast<const QuantizedVertex*>(vertices) + i, count, block.data());
+            }
+            for (size_t j = 0; j < count; ++j)
+            {
+                data->packed[i + j] = {static_cast<float>(block[j].getParameter(0)), static_cast<float>(block[j].getParameter(1)),
+                                       static_cast<float>(block[j].getParameter(2))};
+            }
+        }
+    });
+    Mesh res = FromBuffers(data->packed.data(), VertexFormat::Float, Quantization(), storedCount, edges, edgeCount, data);
+    if (extruded)
+    {
+        Point moved(0, 0, 0, 0);
+        transform.TransformPoints(&extrusion, 1, &moved);
+        res = res.WithExtrusion(moved);
+    }
+    return res;
+}
+
+bool Mesh::IsEmpty() const
+{
+    return edgeCount == 0;
+}
+
+void Mesh::Clear()
+{
+    *this = Mesh();
+}
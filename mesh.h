@@ -0,0 +1,87 @@
+#ifndef MESH_H
+#define MESH_H
+#include <memory>
+#include <vector>
+#include "matrix.h"
+
+struct Edge
+{
+    qint32 a;
+    qint32 b;
+};
+
+class Mesh
+{
+public:
+    enum class VertexFormat : quint32
+    {
+        Float = 0,
+        Quantized16 = 1,
+    };
+    // Maps 16-bit vertex coordinates back to model space: v = q * scale + offset.
+    struct Quantization
+    {
+        double scale[3] = {1, 1, 1};
+        double offset[3] = {0, 0, 0};
+    };
+    // Each contour holds its front half followed by its back half. When
+    // every back half is the front half moved by one common offset the
+    // result is an extrusion.
+    static Mesh FromContours(std::vector<std::vector<Point>> const& contours);
+    // Profiles swept along offset: only the profile vertices are stored and
+    // transformed, vertices from GetStoredVertexCount() on are the profile
+    // moved by offset.
+    static Mesh Extrusion(std::vector<std::vector<Point>> const& profiles, Point const& offset,
+                          VertexFormat format = VertexFormat::Float);
+    static Mesh FromData(std::vector<Point> const& vertices, std::vector<Edge> edges,
+                         VertexFormat format = VertexFormat::Float);
+    static Mesh Torus(int rings, int segments, VertexFormat format = VertexFormat::Float);
+    static Mesh FromBuffers(const void* vertices, VertexFormat format, Quantization const& quantization, size_t vertexCount,
+                            const Edge* edges, size_t edgeCount, std::shared_ptr<const void> owner);
+    static size_t GetVertexSize(VertexFormat format);
+    // GetStoredVertexCount() vertices; for an extrusion that is the profile.
+    const void* GetVertexData() const;
+    size_t GetStoredVertexCount() const;
+    bool IsExtrusion() const;
+    Point GetExtrusion() const;
+    VertexFormat GetVertexFormat() const;
+    Quantization const& GetQuantization() const;
+    Point GetVertex(size_t index) const;
+    // Axis-aligned box of all vertices; false for a mesh without any.
+    bool GetBounds(double lo[3], double hi[3]) const;
+    void TransformVertices(Matrix const& transform, Point* out) const;
+    // screen is a 2x4 map from model space to device coordinates.
+    void ProjectVertices(Matrix const& screen, QPointF* out) const;
+    size_t GetVertexCount() const;
+    const Edge* GetEdges() const;
+    size_t GetEdgeCount() const;
+    // A plain mesh with the same edges; an extrusion is expanded.
+    Mesh WithVertices(std::vector<Point> const& newVertices) const;
+    // The stored vertices become the profile of an extrusion along offset.
+    Mesh WithExtrusion(Point const& offset) const;
+    // The vertices moved by transform into one packed float buffer, with
+    // the edges shared; an extrusion stays one, along the moved offset.
+    Mesh Transformed(Matrix const& transform) const;
+    // The same vertices with edges reordered and flipped into the fewest
+    // chains (each edge starts where the previous one ended), so a
+    // wireframe is submitted as a handful of long polylines. A mesh too
+    // large for 32-bit indices keeps its order.
+    Mesh ToStrips() const;
+    // Number of chains in the current edge order.
+    size_t CountStrips() const;
+    bool IsEmpty() const;
+    void Clear();
+private:
+    std::shared_ptr<const void> storage;
+    const void* vertices = nullptr;
+    VertexFormat format = VertexFormat::Float;
+    Quantization quantization;
+    const Edge* edges = nullptr;
+    size_t vertexCount = 0;
+    size_t edgeCount = 0;
+    size_t storedCount = 0;
+    bool extruded = false;
+    Point extrusion = Point(0, 0, 0, 0);
+};
+
+#endif // MESH_H
@@ -0,0 +1,144 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Range = void (*)(void* context, size_t first, size_t last);
+
+thread_local bool serial = false;
+
+class Pool
+{
+public:
+    Pool()
+    {
+        size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t t = 1; t < hardware; ++t)
+        {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+    size_t GetThreads() const
+    {
+        return workers.size() + 1;
+    }
+    // False, without running anything, when another loop holds the pool.
+    bool Run(size_t count, size_t chunk, Range range, void* context)
+    {
+        if (busy.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = {range, context, count, chunk};
+            next.store(0, std::memory_order_relaxed);
+            ++generation;
+        }
+        wake.notify_all();
+        runChunks();
+        {
+            // Every range is taken once the caller's loop ends; wait for the
+            // workers still running theirs. The job is cleared under the same
+            // lock workers take to join, so a late one never sees it.
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return active == 0; });
+            job = Job();
+        }
+        busy.store(false, std::memory_order_release);
+        return true;
+    }
+private:
+    struct Job
+    {
+        Range range = nullptr;
+        void* context = nullptr;
+        size_t count = 0;
+        size_t chunk = 1;
+    };
+    void runChunks()
+    {
+        for (size_t first = next.fetch_add(job.chunk, std::memory_order_relaxed); first < job.count;
+             first = next.fetch_add(job.chunk, std::memory_order_relaxed))
+        {
+            job.range(job.context, first, std::min(job.count, first + job.chunk));
+        }
+    }
+    void work()
+    {
+        serial = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t seen = 0;
+        while (true)
+        {
+            wake.wait(lock, [&]() { return stopping || (job.range && generation != seen); });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+            ++active;
+            lock.unlock();
+            runChunks();
+            lock.lock();
+            if (--active == 0)
+            {
+                done.notify_one();
+            }
+        }
+    }
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Job job;
+    size_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+    std::atomic<size_t> next{0};
+    std::atomic<bool> busy{false};
+};
+
+Pool& pool()
+{
+    static Pool instance;
+    return instance;
+}
+}
+
+Parallel::SerialScope::SerialScope():
+    previous(serial)
+{
+    serial = true;
+}
+
+Parallel::SerialScope::~SerialScope()
+{
+    serial = previous;
+}
+
+void Parallel::run(size_t count, size_t minimumPerThread, Range range, void* context)
+{
+    size_t threads = serial ? 1 : std::clamp<size_t>(count / std::max<size_t>(minimumPerThread, 1), 1, pool().GetThreads());
+    if (threads == 1 || !pool().Run(count, (count + threads - 1) / threads, range, context))
+    {
+        range(context, 0, count);
+    }
+}
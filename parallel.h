@@ -0,0 +1,45 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+
+// Data-parallel loops over a pool of worker threads started once for the
+// whole process, one per hardware thread besides the caller's. A loop
+// hands the pool a pointer to its body, so starting one allocates nothing.
+class Parallel
+{
+public:
+    // Splits [0, count) into one contiguous range per pool thread and the
+    // caller, none smaller than minimumPerThread, and calls body(first, last)
+    // for each; the caller takes ranges too and returns when all are done.
+    // The pool runs one loop at a time: a loop started while it is busy,
+    // from another thread or nested in a body, runs on its caller alone.
+    template <typename Body>
+    static void For(size_t count, size_t minimumPerThread, Body body)
+    {
+        run(count, minimumPerThread, [](void* context, size_t first, size_t last)
+        {
+            (*static_cast<Body*>(context))(first, last);
+        }, &body);
+    }
+
+    // While one exists, For on this thread runs on the caller alone; for
+    // threads that are already one of many working in parallel, such as
+    // the turntable's renderers.
+    class SerialScope
+    {
+    public:
+        SerialScope();
+        ~SerialScope();
+        SerialScope(SerialScope const&) = delete;
+        SerialScope& operator=(SerialScope const&) = delete;
+    private:
+        bool previous;
+    };
+
+private:
+    using Range = void (*)(void* context, size_t first, size_t last);
+    static void run(size_t count, size_t minimumPerThread, Range range, void* context);
+};
+
+#endif // PARALLEL_H
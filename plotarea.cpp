@@ -3,255 +3,420 @@
 #include <QPainterPath>
 #include <QMessageBox>
 #include <QMouseEvent>
+#include "trace.h"
 
-PlotArea::PlotArea(QWidget *parent):QWidget(parent),
-    AksonometricMatrix(Matrix::GetAksonometricMatrix(angleX, angleY, angleZ)), TransformationMatrix(Matrix::GetIdentityMatrix()),
-    ProjectionMatrix(Matrix::GetIdentityMatrix())
+PlotArea::PlotArea(QWidget *parent):QWidget(parent)
 {
-    u = std::min(width(), height()) / 20;
-    recalculateAxis();
+    renderer.SetUnit(std::min(width(), height()) / 20);
+    refineTimer.setSingleShot(true);
+    refineTimer.setInterval(refine_delay);
+    connect(&refineTimer, &QTimer::timeout, this, &PlotArea::refine);
+    streamTimer.setTimerType(Qt::PreciseTimer);
+    streamTimer.setInterval(stream_poll_ms);
+    connect(&streamTimer, &QTimer::timeout, this, &PlotArea::pollStream);
+}
+
+void PlotArea::beginInteraction()
+{
+    renderer.SetQuality(Renderer::Quality::Preview);
+    refineTimer.start();
+}
+
+void PlotArea::refine()
+{
+    if (mousePressed)
+    {
+        return;
+    }
+    renderer.SetQuality(Renderer::Quality::Refined);
+    update();
 }
 
 void PlotArea::SetRotatable(bool newRotatable)
 {
     isRotatable = newRotatable;
 }
-void PlotArea::recalculateAxis()
+
+QPointF PlotArea::Adjust(const Point& p)
 {
-    axis = Matrix::DecomposeToPoints(AksonometricMatrix * Matrix::ComposeFromPoints({Point(1, 0, 0), Point(0, 1, 0), Point(0, 0, 1)}));
+    return renderer.Adjust(p);
 }
-QPointF PlotArea::Adjust(const Point& _p)
+
+void PlotArea::rebuildMesh()
 {
-    QPointF p = axis[0].toQPoint() * _p.getParameter(0) + axis[1].toQPoint() * _p.getParameter(1) + axis[2].toQPoint() * _p.getParameter(2);
+    DetachStream();
+    size_t edgeCount = renderer.GetMesh().GetEdgeCount();
+    renderer.SetMesh(Mesh::FromContours({figure, innerFigure}));
+    meshChanged(edgeCount == renderer.GetMesh().GetEdgeCount());
+}
 
-    return QPointF(zx + p.x() * u, zy - p.y() * u);
+void PlotArea::meshChanged(bool sameTopology)
+{
+    deformedMeshStale = true;
+    if (sameTopology && !bvh.IsEmpty())
+    {
+        bvhStale = true;
+    }
+    else
+    {
+        bvh.Clear();
+        renderer.SetSelection(-1, -1, -1);
+    }
 }
-void PlotArea::drawBox(QPainter& p)
+
+// Picking works on what is drawn, so under a deformation the BVH is fitted
+// to a deformed copy of the mesh, made on the first pick after a change.
+const Mesh& PlotArea::pickMesh()
 {
-    int h = height() - 2 * box_offset;
-    int w = width() - 2 * box_offset;
-    QPen boxPen(boxColor);
-    boxPen.setWidth(box_width);
-    p.setPen(boxPen);
-    p.drawRect(box_offset, box_offset, w, h);
+    Deformation const& deformation = renderer.GetDeformation();
+    if (deformation.IsIdentity())
+    {
+        return renderer.GetMesh();
+    }
+    if (deformedMeshStale)
+    {
+        deformedMesh = deformation.Deform(renderer.GetMesh());
+        deformedMeshStale = false;
+    }
+    return deformedMesh;
 }
-void PlotArea::drawGrid(QPainter& p)
+
+void PlotArea::pick(QPointF pos)
 {
-    QPen gridPen(gridColor);
-    gridPen.setWidth(1);
-    p.setPen(gridPen);
-    int i = 0;
-    while(zx + i * u <= width() - box_offset)
+    TRACE_SCOPE("input", "pick");
+    renderer.SetSelection(-1, -1, -1);
+    const Mesh& mesh = pickMesh();
+    bool ok;
+    Matrix viewInverse = renderer.GetAksonometricMatrix().inverse(&ok);
+    bool multiView = renderer.IsMultiView();
+    if (mesh.IsEmpty() || !ok || (multiView && (pos.x() < width() / 2 || pos.y() < height() / 2)))
+    {
+        return;
+    }
+    if (bvh.IsEmpty())
+    {
+        bvh.Build(mesh);
+    }
+    else if (bvhStale)
     {
-        i++;
-        p.drawLine(zx + i * u, box_offset, zx + i * u, height() - box_offset);
-        p.drawLine(zx - i * u, box_offset, zx - i * u, height() - box_offset);
+        bvh.Refit(mesh);
     }
-    i = 0;
-    while(zy + i * u < height())
+    bvhStale = false;
+    int u = renderer.getUnit();
+    QPointF center = renderer.GetCenter();
+    double x = (pos.x() - center.x()) / u;
+    double y = (center.y() - pos.y()) / u;
+    std::vector<Point> ray = Matrix::DecomposeToPoints(viewInverse * Matrix::ComposeFromPoints({Point(x, y, 0), Point(0, 0, -1, 0)}));
+    bool halfLine = false;
+    if (!renderer.UnprojectRay(ray, halfLine))
     {
-        i++;
-        p.drawLine(box_offset, zy + i * u, width() - box_offset, zy + i * u);
-        p.drawLine(box_offset, zy - i * u, width() - box_offset, zy - i * u);
+        return;
+    }
+
+    const std::vector<Matrix>& instances = renderer.GetInstances();
+    Matrix model = renderer.GetModelMatrix();
+    std::vector<Matrix> models = instances.empty() ? std::vector<Matrix>{model} : Matrix::ComposeBatch(model, instances);
+    double best = pick_radius;
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        Matrix inverse = models[i].inverse(&ok);
+        if (!ok)
+        {
+            continue;
+        }
+        double norm = 0;
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                norm += inverse.getElement(r, c) * inverse.getElement(r, c);
+            }
+        }
+        norm = std::sqrt(norm);
+        std::vector<Point> local = Matrix::DecomposeToPoints(inverse * Matrix::ComposeFromPoints(ray));
+        Bvh::Hit hit = bvh.Pick(mesh, local[0], local[1], pick_radius * norm / u, halfLine);
+        double distance = hit.distance * u / norm;
+        if (hit.edge >= 0 && distance <= best)
+        {
+            best = distance;
+            renderer.SetSelection(hit.vertex, hit.edge, instances.empty() ? -1 : static_cast<int>(i));
+        }
     }
 }
 
-void PlotArea::drawAxis(QPainter& p)
+void PlotArea::TransformFigure(Matrix const& transform)
 {
-    QPointF center(zx, zy);
+    renderer.TransformFigure(transform);
+}
 
+void PlotArea::ProjectFigure(Matrix::ProjectionType type)
+{
+    renderer.ProjectFigure(type);
+}
 
-    QPen axisPen(XColor);
-    axisPen.setWidth(axis_width);
+void PlotArea::RevertProjection()
+{
+    renderer.RevertProjection();
+}
 
-    p.setPen(axisPen);
-    p.drawLine(Adjust(Point(-axis_length, 0, 0)), Adjust(Point(axis_length, 0, 0)));
+int PlotArea::GetProjection() const
+{
+    return renderer.GetProjection();
+}
 
-    axisPen.setColor(YColor);
-    p.setPen(axisPen);
-    p.drawLine(Adjust(Point(0, -axis_length, 0)), Adjust(Point(0, axis_length, 0)));
+void PlotArea::SetProjection(int projection)
+{
+    renderer.SetProjection(projection);
+}
 
-    axisPen.setColor(ZColor);
-    p.setPen(axisPen);
-    p.drawLine(Adjust(Point(0, 0, -axis_length)), Adjust(Point(0, 0, axis_length)));
+void PlotArea::SetPerspective(double focalLength, double nearDistance)
+{
+    renderer.SetPerspective(focalLength, nearDistance);
+}
 
-    axisPen.setColor(axisColor);
-    p.setPen(axisPen);
-    p.drawLine(center, Adjust({1, 0, 0}));
-    p.drawLine(center, Adjust({0, 1, 0}));
-    p.drawLine(center, Adjust({0, 0, 1}));
+double PlotArea::GetFocalLength() const
+{
+    return renderer.GetFocalLength();
+}
 
+double PlotArea::GetNearDistance() const
+{
+    return renderer.GetNearDistance();
 }
 
-void PlotArea::drawTicks(QPainter& p)
+void PlotArea::ResetTransform()
 {
-    QPen ticksPen(axisColor);
-    ticksPen.setWidth(axis_width);
-    p.setPen(ticksPen);
-    QFont font = p.font();
-    font.setPixelSize(12);
-    p.setFont(font);
+    renderer.ResetTransform();
+}
 
-    int alignFlags = Qt::AlignRight | Qt::AlignTop;
-    p.drawText(QRect{zx  - u + pixel_width, zy + pixel_width, u - pixel_width, u - pixel_width}, alignFlags, QString::number(0));
-    for (int i = 1; i <= axis_length; ++i)
-    {
-        p.drawLine(Adjust(Point(i, 0, -tick_length / 2)), Adjust(Point(i, 0, tick_length / 2)));
-        p.drawLine(Adjust(Point(-i, 0, -tick_length / 2)), Adjust(Point(-i, 0, tick_length / 2)));
+void PlotArea::SetDeformation(Deformation const& deformation)
+{
+    beginInteraction();
+    renderer.SetDeformation(deformation);
+    deformedMeshStale = true;
+    bvhStale = true;
+}
 
-    }
+Deformation const& PlotArea::GetDeformation() const
+{
+    return renderer.GetDeformation();
+}
 
-    for (int i = 1; i <= axis_length; ++i)
-    {
-        p.drawLine(Adjust(Point(0, i, -tick_length / 2)), Adjust(Point(0, i, tick_length / 2)));
-        p.drawLine(Adjust(Point(0, -i, -tick_length / 2)), Adjust(Point(0, -i, tick_length / 2)));
-    }
+void PlotArea::SetAnimationTransform(Matrix const& transform)
+{
+    beginInteraction();
+    renderer.SetAnimationTransform(transform);
+}
 
-    for (int i = 1; i <= axis_length; ++i)
-    {
-        p.drawLine(Adjust(Point(-tick_length / 2, 0, i)), Adjust(Point(tick_length / 2, 0, i)));
-        p.drawLine(Adjust(Point(-tick_length / 2, 0, -i)), Adjust(Point(tick_length / 2, 0, -i)));
-    }
+void PlotArea::ResetAnimationTransform()
+{
+    beginInteraction();
+    renderer.ResetAnimationTransform();
 }
 
-void PlotArea::drawArrows(QPainter& p)
+void PlotArea::SetPreviewTransform(Matrix const& transform)
 {
-    QPen arrowsPen(axisColor);
-    arrowsPen.setWidth((axis_width));
-    p.setBrush(QBrush(axisColor));
-    p.setRenderHint(QPainter::RenderHint::Antialiasing);
+    beginInteraction();
+    renderer.SetPreviewTransform(transform);
+}
 
-    QPainterPath px;
-    px.moveTo(Adjust(Point(axis_length, 0, -tick_length / 2)));
-    px.lineTo(Adjust(Point(axis_length + 1, 0, 0)));
-    px.lineTo(Adjust(Point(axis_length, 0, tick_length / 2)));
-    px.lineTo(Adjust(Point(axis_length, 0, -tick_length / 2)));
-    p.drawPath(px);
-    p.drawText(Adjust(Point(axis_length + 1.5, 1, 0)), "X");
+void PlotArea::ResetPreviewTransform()
+{
+    beginInteraction();
+    renderer.ResetPreviewTransform();
+}
 
-    QPainterPath py;
-    py.moveTo(Adjust(Point(0, axis_length, -tick_length / 2)));
-    py.lineTo(Adjust(Point(0, axis_length + 1, 0)));
-    py.lineTo(Adjust(Point(0, axis_length, tick_length / 2)));
-    py.lineTo(Adjust(Point(0, axis_length, -tick_length / 2)));
-    p.drawPath(py);
-    p.drawText(Adjust(Point(0, axis_length + 1.5, 0)), "Y");
+void PlotArea::AddInstance(Matrix const& transform)
+{
+    renderer.AddInstance(transform);
+}
 
-    QPainterPath pz;
-    pz.moveTo(Adjust(Point(-tick_length / 2, 0, axis_length)));
-    pz.lineTo(Adjust(Point(0, 0, axis_length + 1)));
-    pz.lineTo(Adjust(Point(tick_length / 2, 0, axis_length)));
-    pz.lineTo(Adjust(Point(-tick_length / 2, 0, axis_length)));
-    p.drawPath(pz);
-    p.drawText(Adjust(Point(0, 1, axis_length + 1.5)), "Z");
+void PlotArea::ClearInstances()
+{
+    renderer.ClearInstances();
 }
 
-void PlotArea::drawFigure(QPainter& p)
+size_t PlotArea::GetInstanceCount() const
 {
-    if (!figure.empty() && !innerFigure.empty())
-    {
-        std::vector<Point> toDraw1 = Matrix::DecomposeToPoints(ProjectionMatrix * TransformationMatrix * Matrix::ComposeFromPoints(figure));
-        std::vector<Point> toDraw2 = Matrix::DecomposeToPoints(ProjectionMatrix * TransformationMatrix * Matrix::ComposeFromPoints(innerFigure));
-        QPainterPath ph1;
-        QPainterPath ph2;
-        p.setPen(QPen(Qt::black, line_width));
-        p.setBrush(Qt::NoBrush);
-        int shift1 = toDraw1.size() / 2;
-        ph1.moveTo(Adjust(toDraw1[0]));
-        ph2.moveTo(Adjust(toDraw1[shift1]));
-        p.drawLine(Adjust(toDraw1[0]), Adjust(toDraw1[0 + shift1]));
-        for (size_t i = 1; i < toDraw1.size() / 2; ++i)
-        {
-            ph1.lineTo(Adjust(toDraw1[i]));
-            ph2.lineTo(Adjust(toDraw1[i + shift1]));
-            p.drawLine(Adjust(toDraw1[i]), Adjust(toDraw1[i + shift1]));
-        }
+    return renderer.GetInstanceCount();
+}
 
-        int shift2 = toDraw2.size() / 2;
-        ph1.moveTo(Adjust(toDraw2[0]));
-        ph2.moveTo(Adjust(toDraw2[shift2]));
-        p.drawLine(Adjust(toDraw2[0]), Adjust(toDraw2[0 + shift2]));
-        for (size_t i = 1; i < toDraw2.size() / 2; ++i)
-        {
-            ph1.lineTo(Adjust(toDraw2[i]));
-            ph2.lineTo(Adjust(toDraw2[i + shift2]));
-            p.drawLine(Adjust(toDraw2[i]), Adjust(toDraw2[i + shift2]));
-        }
-        p.drawPath(ph1);
-        p.drawPath(ph2);
-    }
+Matrix PlotArea::GetAccumulatedTransform() const
+{
+    return renderer.GetAccumulatedTransform();
 }
 
-void PlotArea::TransformFigure(Matrix const& transform)
+Matrix PlotArea::GetTransformationMatrix() const
 {
-    TransformationMatrix = transform * TransformationMatrix;
+    return renderer.GetTransformationMatrix();
 }
 
-void PlotArea::ProjectFigure(Matrix::ProjectionType type)
+void PlotArea::SetMultiView(bool multiView)
 {
-    ProjectionMatrix = Matrix::GetProjectionMatrix(type);
+    renderer.SetMultiView(multiView);
 }
 
-void PlotArea::RevertProjection()
+void PlotArea::SetPointCloud(bool pointCloud)
 {
-    ProjectionMatrix = Matrix::GetIdentityMatrix();
+    renderer.SetPointCloud(pointCloud);
 }
 
-void PlotArea::ResetTransform()
+bool PlotArea::IsPointCloud() const
 {
-    TransformationMatrix = Matrix::GetIdentityMatrix();
+    return renderer.IsPointCloud();
 }
 
-Matrix PlotArea::GetTransformationMatrix() const
+const Renderer& PlotArea::GetRenderer() const
 {
-    return ProjectionMatrix * TransformationMatrix;
+    return renderer;
 }
 
 void PlotArea::SetFigurePoints(const std::vector<Point>& data)
 {
     figure = data;
+    rebuildMesh();
+}
+
+void PlotArea::SetMesh(Mesh const& newMesh, bool stripOrdered)
+{
+    DetachStream();
+    figure.clear();
+    innerFigure.clear();
+    if (stripOrdered)
+    {
+        renderer.SetStripMesh(newMesh);
+    }
+    else
+    {
+        renderer.SetMesh(newMesh);
+    }
+    meshChanged(false);
+}
+
+bool PlotArea::AttachStream(QString const& key, QString* error)
+{
+    DetachStream();
+    if (!stream.Attach(key, error))
+    {
+        return false;
+    }
+    figure.clear();
+    innerFigure.clear();
+    renderer.SetStripMesh(stream.GetMesh());
+    meshChanged(false);
+    paintedStreamFrame = stream.GetSequence();
+    skippedStreamFrames = 0;
+    streamLatencyMs = 0;
+    streamTimer.start();
+    update();
+    return true;
+}
+
+void PlotArea::DetachStream()
+{
+    streamTimer.stop();
+    stream.Detach();
+}
+
+bool PlotArea::IsStreaming() const
+{
+    return stream.IsAttached();
+}
+
+quint64 PlotArea::GetStreamFrame() const
+{
+    return paintedStreamFrame;
+}
+
+quint64 PlotArea::GetSkippedStreamFrames() const
+{
+    return skippedStreamFrames;
+}
+
+double PlotArea::GetStreamLatency() const
+{
+    return streamLatencyMs;
+}
+
+// The renderer takes a view of the newest slot; the slot it showed before
+// is only handed back to the producer by this Acquire, after the last
+// paint that used it.
+void PlotArea::pollStream()
+{
+    if (!stream.Acquire())
+    {
+        if (!stream.IsAttached())
+        {
+            streamTimer.stop();
+            QMessageBox::warning(this, "Ошибка", "Разделяемая память потока повреждена, поток отключён");
+        }
+        return;
+    }
+    TRACE_SCOPE("stream", "pollStream");
+    renderer.SetStripMesh(stream.GetMesh());
+    meshChanged(true);
+    update();
+}
+
+const Mesh& PlotArea::GetMesh() const
+{
+    return renderer.GetMesh();
 }
 
 void PlotArea::SetInnerFigurePoints(const std::vector<Point> &data)
 {
     innerFigure = data;
+    rebuildMesh();
 }
 
 void PlotArea::Clear()
 {
     figure.clear();
     innerFigure.clear();
+    rebuildMesh();
 }
 
 void PlotArea::paintEvent(QPaintEvent*)
 {
-    zx = width() / 2;
-    zy = height() / 2;
-    AksonometricMatrix = Matrix::GetAksonometricMatrix(angleX, angleY, angleZ);
-    recalculateAxis();
+    TRACE_SCOPE("paint", "paintEvent");
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Painter);
     QPainter pt(this);
-    drawBox(pt);
-    drawAxis(pt);
-    drawTicks(pt);
-    drawArrows(pt);
-    drawFigure(pt);
+    renderer.Render(pt, size());
+    if (stream.IsAttached() && stream.GetSequence() != paintedStreamFrame)
+    {
+        if (stream.GetSequence() > paintedStreamFrame + 1)
+        {
+            skippedStreamFrames += stream.GetSequence() - paintedStreamFrame - 1;
+        }
+        paintedStreamFrame = stream.GetSequence();
+        streamLatencyMs = (Stream::Now() - stream.GetTimestamp()) / 1e6;
+    }
+    emit FrameRendered();
 }
 
 void PlotArea::mousePressEvent(QMouseEvent* event)
 {
+    TRACE_SCOPE("input", "mousePressEvent");
     lastMousePos = event->position();
+    pressMousePos = lastMousePos;
     mousePressed = true;
+    refineTimer.stop();
+    renderer.SetQuality(Renderer::Quality::Preview);
 }
 
 void PlotArea::mouseMoveEvent(QMouseEvent* event)
 {
+    TRACE_SCOPE("input", "mouseMoveEvent");
     if (mousePressed && isRotatable)
     {
         QPointF pos = event->position();
         double deltaX = pos.x() - lastMousePos.x();
         double deltaY = pos.y() - lastMousePos.y();
+        double angleX, angleY, angleZ;
+        renderer.GetRotation(angleX, angleY, angleZ);
         angleY += angleShift * deltaX;
         angleX += angleShift * deltaY;
+        renderer.SetRotation(angleX, angleY, angleZ);
         lastMousePos = pos;
         repaint();
     }
@@ -259,31 +424,77 @@ void PlotArea::mouseMoveEvent(QMouseEvent* event)
 
 void PlotArea::SetRotation(double _angleX, double _angleY, double _angleZ)
 {
-    angleX = _angleX;
-    angleY = _angleY;
-    angleZ = _angleZ;
+    renderer.SetRotation(_angleX, _angleY, _angleZ);
+}
+
+void PlotArea::GetRotation(double& _angleX, double& _angleY, double& _angleZ) const
+{
+    renderer.GetRotation(_angleX, _angleY, _angleZ);
 }
 
-void PlotArea::mouseReleaseEvent(QMouseEvent*)
+void PlotArea::mouseReleaseEvent(QMouseEvent* event)
 {
+    TRACE_SCOPE("input", "mouseReleaseEvent");
     mousePressed = false;
+    refineTimer.start();
+    QPointF delta = event->position() - pressMousePos;
+    if (std::abs(delta.x()) + std::abs(delta.y()) <= click_distance)
+    {
+        pick(event->position());
+        emit SelectionChanged();
+        repaint();
+    }
 }
 
 void PlotArea::wheelEvent(QWheelEvent* event)
 {
-    SetUnit(u + delta_unit * (2 * (event->angleDelta().y() > 0) - 1));
+    TRACE_SCOPE("input", "wheelEvent");
+    beginInteraction();
+    SetUnit(renderer.getUnit() + delta_unit * (2 * (event->angleDelta().y() > 0) - 1));
     repaint();
 }
 
+int PlotArea::GetSelectedVertex() const
+{
+    return renderer.GetSelectedVertex();
+}
+
+int PlotArea::GetSelectedEdge() const
+{
+    return renderer.GetSelectedEdge();
+}
+
+Renderer::QualityStats PlotArea::GetQualityStats(Renderer::Quality quality) const
+{
+    return renderer.GetQualityStats(quality);
+}
+
 int PlotArea::getUnit() const
 {
-    return u;
+    return renderer.getUnit();
+}
+
+void PlotArea::FitToView()
+{
+    TRACE_SCOPE("input", "FitToView");
+    QRectF box;
+    if (!renderer.GetViewBounds(box))
+    {
+        return;
+    }
+    QSizeF view = renderer.IsMultiView() ? QSizeF(width() / 2, height() / 2) : QSizeF(size());
+    double fill = 1 - 2 * fit_margin;
+    double unit = std::min(view.width() * fill / std::max(box.width(), 1e-9),
+                           view.height() * fill / std::max(box.height(), 1e-9));
+    renderer.SetUnit(std::clamp(int(unit), min_unit, max_unit));
+    renderer.SetPan(-box.center());
+    repaint();
 }
 
 void PlotArea::SetUnit(int nu)
 {
     if (nu >= min_unit && nu <= max_unit)
     {
-        u = nu;
+        renderer.SetUnit(nu);
     }
 }
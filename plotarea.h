@@ -3,8 +3,13 @@
 
 #include <QPainter>
 #include <QWidget>
+#include <QTimer>
 #include <vector>
 #include "matrix.h"
+#include "mesh.h"
+#include "bvh.h"
+#include "renderer.h"
+#include "stream.h"
 
 class PlotArea : public QWidget
 {
@@ -13,55 +18,92 @@ public:
     explicit PlotArea(QWidget *parent = nullptr);
     void SetFigurePoints(const std::vector<Point>& data);
     void SetInnerFigurePoints(const std::vector<Point>& data);
+    // stripOrdered skips the reordering for edges already in strip order,
+    // such as a scene saved from the renderer.
+    void SetMesh(Mesh const& newMesh, bool stripOrdered = false);
+    const Mesh& GetMesh() const;
     void TransformFigure(Matrix const& transform);
     void ProjectFigure(Matrix::ProjectionType type);
     void RevertProjection();
+    int GetProjection() const;
+    void SetProjection(int projection);
+    void SetPerspective(double focalLength, double nearDistance);
+    double GetFocalLength() const;
+    double GetNearDistance() const;
     void ResetTransform();
+    void SetDeformation(Deformation const& deformation);
+    Deformation const& GetDeformation() const;
+    void SetAnimationTransform(Matrix const& transform);
+    void ResetAnimationTransform();
+    void SetPreviewTransform(Matrix const& transform);
+    void ResetPreviewTransform();
+    void AddInstance(Matrix const& transform);
+    void ClearInstances();
+    size_t GetInstanceCount() const;
+    void SetMultiView(bool multiView);
+    void SetPointCloud(bool pointCloud);
+    bool IsPointCloud() const;
     void SetRotatable(bool newRotatable);
     void SetRotation(double _angleX, double _angleY, double _angleZ);
+    void GetRotation(double& _angleX, double& _angleY, double& _angleZ) const;
     Matrix GetTransformationMatrix() const;
+    Matrix GetAccumulatedTransform() const;
+    const Renderer& GetRenderer() const;
     QPointF Adjust(const Point& p);
     void Clear();
     void SetUnit(int nu);
     int getUnit() const;
+    // Zooms and pans so the whole model fills the view.
+    void FitToView();
+    // Shows the frames a Stream producer publishes under key until another
+    // mesh is set. Frames are picked up by polling, at most one per paint.
+    bool AttachStream(QString const& key, QString* error);
+    void DetachStream();
+    bool IsStreaming() const;
+    quint64 GetStreamFrame() const;
+    quint64 GetSkippedStreamFrames() const;
+    // From publication by the producer to the end of the frame's paint.
+    double GetStreamLatency() const;
+    int GetSelectedVertex() const;
+    int GetSelectedEdge() const;
+    Renderer::QualityStats GetQualityStats(Renderer::Quality quality) const;
+signals:
+    void SelectionChanged();
+    void FrameRendered();
 private:
     bool isRotatable = true;
     bool mousePressed = false;
     QPointF lastMousePos;
-    double angleX = 19.47 / 180 * 3.14;
-    double angleY = -20.7 / 180 * 3.14;
-    double angleZ = 0;
+    QPointF pressMousePos;
     double angleShift = 0.005;
-    std::vector<Point> axis;
-    Matrix AksonometricMatrix, TransformationMatrix, ProjectionMatrix;
-    int u;
+    Renderer renderer;
+    Bvh bvh;
+    bool bvhStale = false;
+    Mesh deformedMesh;
+    bool deformedMeshStale = true;
+    int pick_radius = 6;
+    int click_distance = 3;
     int min_unit = 5;
     int max_unit = 40;
     int delta_unit = 1;
-    double tick_length = 1.0;
-    int axis_width = 2;
-    int box_offset = 1;
-    int box_width = 1;
-    int pixel_width = 1;
-    int line_width = 3;
-    int axis_length = 20;
-    int zx = 0;
-    int zy = 0;
+    double fit_margin = 0.05;
+    int refine_delay = 200;
+    QTimer refineTimer;
+    Stream::Consumer stream;
+    QTimer streamTimer;
+    int stream_poll_ms = 2;
+    quint64 paintedStreamFrame = 0;
+    quint64 skippedStreamFrames = 0;
+    double streamLatencyMs = 0;
     std::vector<Point> figure;
     std::vector<Point> innerFigure;
-    QColor XColor = Qt::blue;
-    QColor YColor = Qt::green;
-    QColor ZColor = Qt::magenta;
-    QColor gridColor = Qt::gray;
-    QColor axisColor = Qt::black;
-    QColor boxColor = Qt::gray;
-    void recalculateAxis();
-    void inline drawBox(QPainter(&p));
-    void inline drawGrid(QPainter& p);
-    void inline drawAxis(QPainter& p);
-    void inline drawTicks(QPainter& p);
-    void inline drawArrows(QPainter& p);
-    void inline drawFigure(QPainter& p);
+    void rebuildMesh();
+    void meshChanged(bool sameTopology);
+    const Mesh& pickMesh();
+    void pick(QPointF pos);
+    void beginInteraction();
+    void refine();
+    void pollStream();
     void paintEvent(QPaintEvent* event) override;
     virtual void mousePressEvent(QMouseEvent* event) override;
     virtual void mouseReleaseEvent(QMouseEvent* event) override;
@@ -0,0 +1,305 @@
+#include "pointsplatter.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert(std::atomic<quint32>::is_always_lock_free, "depth cells are updated by many threads at once");
+
+namespace
+{
+const size_t minimumPerThread = 1 << 16;
+const size_t minimumRowsPerThread = 64;
+const quint32 emptyDepth = 0xFFFFFFFF;
+// Grey of the farthest point; the nearest is black.
+const float farShade = 200;
+
+// Float bits reordered so that unsigned comparison follows the float
+// order: positive values get the sign bit set, negative ones are flipped.
+inline quint32 depthKey(float depth)
+{
+    quint32 bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+inline float keyDepth(quint32 key)
+{
+    quint32 bits = key & 0x80000000u ? key & 0x7FFFFFFFu : ~key;
+    float depth;
+    std::memcpy(&depth, &bits, sizeof(depth));
+    return depth;
+}
+
+inline void atomicMin(std::atomic<quint32>& cell, quint32 value)
+{
+    quint32 current = cell.load(std::memory_order_relaxed);
+    while (value < current && !cell.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+inline void atomicMax(std::atomic<quint32>& cell, quint32 value)
+{
+    quint32 current = cell.load(std::memory_order_relaxed);
+    while (value > current && !cell.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// A View with the vertex format's scale and offset folded into the rows,
+// in floats for the per-vertex loop.
+struct Kernel
+{
+    float m[12];
+    float focalLength;
+    float zMax;
+    float screen[4];
+    float cx, cy;
+    float left, top, right, bottom;
+};
+
+template <typename Vertex>
+inline void loadVertex(Vertex const& v, float& x, float& y, float& z)
+{
+    x = v.x;
+    y = v.y;
+    z = v.z;
+}
+
+inline void loadVertex(Point const& p, float& x, float& y, float& z)
+{
+    x = static_cast<float>(p.getParameter(0));
+    y = static_cast<float>(p.getParameter(1));
+    z = static_cast<float>(p.getParameter(2));
+}
+
+template <bool perspective, typename Vertex>
+void splatRange(Kernel const& k, const Vertex* vertices, size_t first, size_t last, size_t stride,
+                std::atomic<quint32>* depth, size_t width)
+{
+    for (size_t i = first; i < last; i += stride)
+    {
+        float vx, vy, vz;
+        loadVertex(vertices[i], vx, vy, vz);
+        float x = k.m[0] * vx + k.m[1] * vy + k.m[2] * vz + k.m[3];
+        float y = k.m[4] * vx + k.m[5] * vy + k.m[6] * vz + k.m[7];
+        float z = k.m[8] * vx + k.m[9] * vy + k.m[10] * vz + k.m[11];
+        if (perspective)
+        {
+            if (!(z <= k.zMax))
+            {
+                continue;
+            }
+            float s = k.focalLength / (k.focalLength - z);
+            float px = x * s;
+            float py = y * s;
+            x = k.screen[0] * px + k.screen[1] * py + k.cx;
+            y = k.screen[2] * px + k.screen[3] * py + k.cy;
+            z = k.focalLength - z;
+        }
+        // Also false for NaN.
+        if (!(x >= k.left && x < k.right && y >= k.top && y < k.bottom))
+        {
+            continue;
+        }
+        size_t cell = static_cast<size_t>(static_cast<int>(y)) * width + static_cast<int>(x);
+        atomicMin(depth[cell], depthKey(z));
+    }
+}
+
+// Every stride-th of count vertices, split between threads.
+template <typename Vertex>
+void splatAll(Kernel const& k, bool perspective, const Vertex* vertices, size_t count, size_t stride,
+              std::atomic<quint32>* depth, size_t width)
+{
+    size_t steps = (count + stride - 1) / stride;
+    Parallel::For(steps, minimumPerThread, [&](size_t first, size_t last)
+    {
+        if (perspective)
+        {
+            splatRange<true>(k, vertices, first * stride, std::min(last * stride, count), stride, depth, width);
+        }
+        else
+        {
+            splatRange<false>(k, vertices, first * stride, std::min(last * stride, count), stride, depth, width);
+        }
+    });
+}
+
+// The parts of a View that do not depend on the vertex format; the caller
+// fills m.
+Kernel makeKernel(PointSplatter::View const& view, QRect clip)
+{
+    Kernel k;
+    k.focalLength = static_cast<float>(view.focalLength);
+    k.zMax = static_cast<float>(view.focalLength - view.nearDistance);
+    for (int i = 0; i < 4; ++i)
+    {
+        k.screen[i] = static_cast<float>(view.screen[i]);
+    }
+    k.cx = static_cast<float>(view.center.x());
+    k.cy = static_cast<float>(view.center.y());
+    k.left = static_cast<float>(clip.left());
+    k.top = static_cast<float>(clip.top());
+    k.right = static_cast<float>(clip.right() + 1);
+    k.bottom = static_cast<float>(clip.bottom() + 1);
+    return k;
+}
+}
+
+PointSplatter::PointSplatter(PointSplatter const&)
+{
+}
+
+PointSplatter& PointSplatter::operator=(PointSplatter const&)
+{
+    return *this;
+}
+
+void PointSplatter::Begin(QSize size)
+{
+    if (image.size() == size)
+    {
+        return;
+    }
+    image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    cellCount = static_cast<size_t>(std::max(size.width(), 0)) * std::max(size.height(), 0);
+    depth.reset(new std::atomic<quint32>[cellCount]);
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        depth[i].store(emptyDepth, std::memory_order_relaxed);
+    }
+}
+
+void PointSplatter::Splat(Mesh const& mesh, View const& view)
+{
+    TRACE_SCOPE("paint", "PointSplatter::Splat");
+    QRect clip = view.clip & QRect(QPoint(0, 0), image.size());
+    if (clip.isEmpty() || mesh.GetVertexCount() == 0)
+    {
+        return;
+    }
+    double scale[3] = {1, 1, 1};
+    double offset[3] = {0, 0, 0};
+    if (mesh.GetVertexFormat() == Mesh::VertexFormat::Quantized16)
+    {
+        std::copy(mesh.GetQuantization().scale, mesh.GetQuantization().scale + 3, scale);
+        std::copy(mesh.GetQuantization().offset, mesh.GetQuantization().offset + 3, offset);
+    }
+    bool perspective = view.focalLength > 0;
+    Kernel k = makeKernel(view, clip);
+    size_t stored = mesh.GetStoredVertexCount();
+    size_t stride = std::max<size_t>(view.stride, 1);
+    size_t width = static_cast<size_t>(image.width());
+    // The back copy of an extrusion is the same vertices with the
+    // extrusion added to the offset.
+    for (int part = 0; part < (mesh.IsExtrusion() ? 2 : 1); ++part)
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            double translation = view.rows[4 * r + 3];
+            for (int c = 0; c < 3; ++c)
+            {
+                double moved = offset[c] + (part == 1 ? mesh.GetExtrusion().getParameter(c) : 0);
+                k.m[4 * r + c] = static_cast<float>(view.rows[4 * r + c] * scale[c]);
+                translation += view.rows[4 * r + c] * moved;
+            }
+            k.m[4 * r + 3] = static_cast<float>(translation);
+        }
+        if (mesh.GetVertexFormat() == Mesh::VertexFormat::Float)
+        {
+            splatAll(k, perspective, static_cast<const PackedVertex*>(mesh.GetVertexData()), stored, stride, depth.get(), width);
+        }
+        else
+        {
+            splatAll(k, perspective, static_cast<const QuantizedVertex*>(mesh.GetVertexData()), stored, stride, depth.get(), width);
+        }
+    }
+}
+
+void PointSplatter::Splat(const Point* points, size_t count, View const& view)
+{
+    TRACE_SCOPE("paint", "PointSplatter::Splat");
+    QRect clip = view.clip & QRect(QPoint(0, 0), image.size());
+    if (clip.isEmpty() || count == 0)
+    {
+        return;
+    }
+    Kernel k = makeKernel(view, clip);
+    for (int i = 0; i < 12; ++i)
+    {
+        k.m[i] = static_cast<float>(view.rows[i]);
+    }
+    splatAll(k, view.focalLength > 0, points, count, std::max<size_t>(view.stride, 1), depth.get(), static_cast<size_t>(image.width()));
+}
+
+void PointSplatter::Resolve(QRect rect)
+{
+    TRACE_SCOPE("paint", "PointSplatter::Resolve");
+    rect &= QRect(QPoint(0, 0), image.size());
+    if (rect.isEmpty())
+    {
+        return;
+    }
+    size_t width = static_cast<size_t>(image.width());
+    size_t rows = static_cast<size_t>(rect.height());
+    std::atomic<quint32> nearest{emptyDepth};
+    std::atomic<quint32> farthest{0};
+    Parallel::For(rows, minimumRowsPerThread, [&](size_t first, size_t last)
+    {
+        quint32 lo = emptyDepth;
+        quint32 hi = 0;
+        for (size_t y = rect.top() + first; y < rect.top() + last; ++y)
+        {
+            const std::atomic<quint32>* row = depth.get() + y * width;
+            for (int x = rect.left(); x <= rect.right(); ++x)
+            {
+                quint32 key = row[x].load(std::memory_order_relaxed);
+                if (key != emptyDepth)
+                {
+                    lo = std::min(lo, key);
+                    hi = std::max(hi, key);
+                }
+            }
+        }
+        atomicMin(nearest, lo);
+        atomicMax(farthest, hi);
+    });
+    float nearDepth = keyDepth(nearest);
+    float range = nearest != emptyDepth ? keyDepth(farthest) - nearDepth : 0;
+    float shadeScale = range > 0 ? farShade / range : 0;
+    uchar* bits = image.bits();
+    qsizetype bytesPerLine = image.bytesPerLine();
+    Parallel::For(rows, minimumRowsPerThread, [&](size_t first, size_t last)
+    {
+        for (size_t y = rect.top() + first; y < rect.top() + last; ++y)
+        {
+            std::atomic<quint32>* row = depth.get() + y * width;
+            QRgb* pixels = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+            for (int x = rect.left(); x <= rect.right(); ++x)
+            {
+                quint32 key = row[x].load(std::memory_order_relaxed);
+                if (key == emptyDepth)
+                {
+                    pixels[x] = 0;
+                    continue;
+                }
+                int shade = static_cast<int>((keyDepth(key) - nearDepth) * shadeScale);
+                pixels[x] = qRgb(shade, shade, shade);
+                row[x].store(emptyDepth, std::memory_order_relaxed);
+            }
+        }
+    });
+}
+
+QImage const& PointSplatter::GetImage() const
+{
+    return image;
+}
+
+size_t PointSplatter::GetBytes() const
+{
+    return static_cast<size_t>(image.sizeInBytes()) + cellCount * sizeof(quint32);
+}
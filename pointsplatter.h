@@ -0,0 +1,59 @@
+#ifndef POINTSPLATTER_H
+#define POINTSPLATTER_H
+
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+#include <atomic>
+#include <memory>
+#include "mesh.h"
+
+// Draws the vertices of a mesh as single pixels straight into an image,
+// for point clouds far too large to go through QPainter point by point.
+// The vertices are split between threads; each keeps the nearest point of
+// every pixel with an atomic minimum on a shared depth buffer, so threads
+// never wait for each other. Resolve then shades the pixels by depth,
+// nearer points darker.
+class PointSplatter
+{
+public:
+    // From model space to device pixels and depth. A parallel view is
+    // affine: rows are x, y and depth (growing away from the viewer) of a
+    // 3x4 matrix. With focalLength > 0 the rows give camera x, y and z
+    // instead; points beyond focalLength - nearDistance are dropped, the
+    // rest are divided by focalLength - z, mapped by the 2x2 screen matrix
+    // and moved to center.
+    struct View
+    {
+        double rows[12] = {};
+        double focalLength = 0;
+        double nearDistance = 0;
+        double screen[4] = {1, 0, 0, 1};
+        QPointF center;
+        QRect clip;
+        // Only every stride-th vertex is drawn.
+        size_t stride = 1;
+    };
+    PointSplatter() = default;
+    // The buffers only live for a frame, so a copy starts without them.
+    PointSplatter(PointSplatter const&);
+    PointSplatter& operator=(PointSplatter const&);
+    // Starts a frame; the buffers are only reallocated when size changes.
+    void Begin(QSize size);
+    void Splat(Mesh const& mesh, View const& view);
+    // The same for vertices already moved by the model transform, such as
+    // the world buffer every view of the four-view layout shares.
+    void Splat(const Point* points, size_t count, View const& view);
+    // Writes the pixels inside rect to the image, shaded across the depth
+    // range found inside rect, and clears their depth for the next frame.
+    void Resolve(QRect rect);
+    QImage const& GetImage() const;
+    size_t GetBytes() const;
+private:
+    QImage image;
+    std::unique_ptr<std::atomic<quint32>[]> depth;
+    size_t cellCount = 0;
+};
+
+#endif // POINTSPLATTER_H
@@ -0,0 +1,81 @@
+#include "projection.h"
+#include <cmath>
+
+int Projection::GetDroppedAxis(int projection)
+{
+    switch (static_cast<Matrix::ProjectionType>(projection))
+    {
+    case Matrix::ProjectionType::ProjectionOXY:
+        return 2;
+    case Matrix::ProjectionType::ProjectionOXZ:
+        return 1;
+    case Matrix::ProjectionType::ProjectionOYZ:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+double Projection::GetDepthScale(int projection)
+{
+    return static_cast<Matrix::ProjectionType>(projection) == Matrix::ProjectionType::ProjectionCabinet ? 0.5 : 1;
+}
+
+void Projection::Oblique(Point* points, size_t count, double depthScale, double angle)
+{
+    double dx = depthScale * cos(angle);
+    double dy = depthScale * sin(angle);
+    for (size_t i = 0; i < count; ++i)
+    {
+        double z = points[i].getParameter(2);
+        points[i] = Point(points[i].getParameter(0) + dx * z, points[i].getParameter(1) + dy * z, 0);
+    }
+}
+
+void Projection::Perspective(Point* points, size_t count, char* visible, double focalLength, double nearDistance)
+{
+    double zMax = focalLength - nearDistance;
+    for (size_t i = 0; i < count; ++i)
+    {
+        double z = points[i].getParameter(2);
+        visible[i] = z <= zMax;
+        if (visible[i])
+        {
+            double s = focalLength / (focalLength - z);
+            points[i] = Point(points[i].getParameter(0) * s, points[i].getParameter(1) * s, 0);
+        }
+    }
+}
+
+Point Projection::PerspectivePoint(Point const& p, double focalLength)
+{
+    double s = focalLength / (focalLength - p.getParameter(2));
+    return Point(p.getParameter(0) * s, p.getParameter(1) * s, 0);
+}
+
+bool Projection::ClipToNearPlane(Point& a, Point& b, double focalLength, double nearDistance)
+{
+    double zMax = focalLength - nearDistance;
+    double za = a.getParameter(2);
+    double zb = b.getParameter(2);
+    if (za > zMax && zb > zMax)
+    {
+        return false;
+    }
+    if (za <= zMax && zb <= zMax)
+    {
+        return true;
+    }
+    double t = (zMax - za) / (zb - za);
+    Point clipped(a.getParameter(0) + t * (b.getParameter(0) - a.getParameter(0)),
+                  a.getParameter(1) + t * (b.getParameter(1) - a.getParameter(1)), zMax);
+    if (za > zMax)
+    {
+        a = clipped;
+    }
+    else
+    {
+        b = clipped;
+    }
+    return true;
+}
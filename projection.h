@@ -0,0 +1,18 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <cstddef>
+#include "matrix.h"
+
+class Projection
+{
+public:
+    static int GetDroppedAxis(int projection);
+    static double GetDepthScale(int projection);
+    static void Oblique(Point* points, size_t count, double depthScale, double angle);
+    static void Perspective(Point* points, size_t count, char* visible, double focalLength, double nearDistance);
+    static Point PerspectivePoint(Point const& p, double focalLength);
+    static bool ClipToNearPlane(Point& a, Point& b, double focalLength, double nearDistance);
+};
+
+#endif // PROJECTION_H
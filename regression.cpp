@@ -0,0 +1,444 @@
+#include "regression.h"
+#include "renderer.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+struct ModelSpec
+{
+    const char* name;
+    Mesh (*build)();
+};
+
+struct AngleSpec
+{
+    const char* name;
+    bool useDefault;
+    double angleX;
+    double angleY;
+    double angleZ;
+};
+
+struct ProjectionSpec
+{
+    const char* name;
+    int projection;
+};
+
+struct TransformSpec
+{
+    const char* name;
+    Matrix (*build)();
+};
+
+// The figure MainWindow starts with.
+Mesh letterMesh()
+{
+    return Mesh::FromContours({
+        {Point(1, 1, 1), Point(4, 1, 1), Point(4, 3, 1), Point(2, 3, 1), Point(2, 4, 1), Point(4, 4, 1), Point(4, 5, 1), Point(1, 5, 1), Point(1, 1, 1),
+         Point(1, 1, 2), Point(4, 1, 2), Point(4, 3, 2), Point(2, 3, 2), Point(2, 4, 2), Point(4, 4, 2), Point(4, 5, 2), Point(1, 5, 2), Point(1, 1, 2)},
+        {Point(2, 1.5, 1), Point(3.5, 1.5, 1), Point(3.5, 2.5, 1), Point(2, 2.5, 1), Point(2, 1.5, 1),
+         Point(2, 1.5, 2), Point(3.5, 1.5, 2), Point(3.5, 2.5, 2), Point(2, 2.5, 2), Point(2, 1.5, 2)}});
+}
+
+Mesh torusMesh()
+{
+    return Mesh::Torus(12, 24);
+}
+
+Mesh quantizedTorusMesh()
+{
+    return Mesh::Torus(12, 24, Mesh::VertexFormat::Quantized16);
+}
+
+Matrix identityTransform()
+{
+    return Matrix::GetIdentityMatrix();
+}
+
+Matrix compositeTransform()
+{
+    return Matrix::GetTranslationMatrix(1, -2, 0.5)
+         * Matrix::GetRotationMatrix(Matrix::RotationType::RotationOZ, 0.4)
+         * Matrix::GetScaleMatrix(1.5, 0.75, 1.25);
+}
+
+const ModelSpec models[] = {
+    {"letter", letterMesh},
+    {"torus", torusMesh},
+    {"torus16", quantizedTorusMesh},
+};
+
+const AngleSpec angles[] = {
+    {"default", true, 0, 0, 0},
+    {"front", false, 0, 0, 0},
+    {"oblique", false, 35.0 / 180 * M_PI, 40.0 / 180 * M_PI, 10.0 / 180 * M_PI},
+};
+
+const ProjectionSpec projections[] = {
+    {"axonometric", -1},
+    {"oxy", static_cast<int>(Matrix::ProjectionType::ProjectionOXY)},
+    {"perspective", static_cast<int>(Matrix::ProjectionType::ProjectionPerspective)},
+    {"cabinet", static_cast<int>(Matrix::ProjectionType::ProjectionCabinet)},
+};
+
+const TransformSpec transforms[] = {
+    {"identity", identityTransform},
+    {"composite", compositeTransform},
+};
+
+const QSize imageSize(640, 480);
+const int stripGraphs = 200;
+const int warmupFrames = 2;
+const int measuredFrames = 10;
+
+// Renders one case the way PlotArea paints itself and returns the image and
+// the average time per frame.
+QImage renderCase(Renderer& renderer, double& ms)
+{
+    QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    QElapsedTimer timer;
+    for (int frame = 0; frame < warmupFrames + measuredFrames; ++frame)
+    {
+        if (frame == warmupFrames)
+        {
+            timer.start();
+        }
+        image.fill(Qt::white);
+        renderer.Render(painter, imageSize);
+    }
+    ms = timer.nsecsElapsed() / 1e6 / measuredFrames;
+    painter.end();
+    return image;
+}
+
+// Small multigraphs with parallel edges, self-loops, isolated vertices
+// and several components, the cases the strip ordering has to get right.
+Mesh randomMultigraph(std::mt19937& random)
+{
+    int vertexCount = std::uniform_int_distribution<int>(1, 40)(random);
+    int edgeCount = std::uniform_int_distribution<int>(0, 80)(random);
+    std::uniform_int_distribution<qint32> vertex(0, vertexCount - 1);
+    std::vector<Point> vertices;
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        vertices.push_back(Point(i, i % 7, i % 3));
+    }
+    std::vector<Edge> edges;
+    for (int i = 0; i < edgeCount; ++i)
+    {
+        edges.push_back({vertex(random), vertex(random)});
+    }
+    return Mesh::FromData(vertices, std::move(edges));
+}
+
+// Edges as sorted unordered pairs, comparable as multisets.
+std::vector<std::pair<qint32, qint32>> edgeMultiset(Mesh const& mesh)
+{
+    std::vector<std::pair<qint32, qint32>> pairs;
+    for (size_t i = 0; i < mesh.GetEdgeCount(); ++i)
+    {
+        Edge const& e = mesh.GetEdges()[i];
+        pairs.emplace_back(std::min(e.a, e.b), std::max(e.a, e.b));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+// The fewest trails covering every edge once: for each connected component
+// with edges, half its odd-degree vertices, or one when it has none.
+size_t minimumStrips(Mesh const& mesh)
+{
+    std::vector<size_t> parent(mesh.GetVertexCount());
+    std::vector<int> degree(mesh.GetVertexCount(), 0);
+    for (size_t v = 0; v < parent.size(); ++v)
+    {
+        parent[v] = v;
+    }
+    auto root = [&parent](size_t v)
+    {
+        while (parent[v] != v)
+        {
+            v = parent[v] = parent[parent[v]];
+        }
+        return v;
+    };
+    for (size_t i = 0; i < mesh.GetEdgeCount(); ++i)
+    {
+        Edge const& e = mesh.GetEdges()[i];
+        degree[e.a]++;
+        degree[e.b]++;
+        parent[root(e.a)] = root(e.b);
+    }
+    std::vector<size_t> odd(parent.size(), 0);
+    std::vector<char> hasEdges(parent.size(), 0);
+    for (size_t v = 0; v < parent.size(); ++v)
+    {
+        odd[root(v)] += degree[v] % 2;
+        hasEdges[root(v)] |= degree[v] > 0;
+    }
+    size_t strips = 0;
+    for (size_t v = 0; v < parent.size(); ++v)
+    {
+        if (hasEdges[v])
+        {
+            strips += std::max<size_t>(odd[v] / 2, 1);
+        }
+    }
+    return strips;
+}
+
+// What is wrong with mesh.ToStrips(): edges lost, added or changed, or more
+// chains than the minimum.
+QStringList checkStrips(Mesh const& mesh)
+{
+    Mesh strips = mesh.ToStrips();
+    QStringList problems;
+    if (edgeMultiset(strips) != edgeMultiset(mesh))
+    {
+        problems.append("набор рёбер изменился");
+    }
+    size_t expected = minimumStrips(mesh);
+    if (strips.CountStrips() != expected)
+    {
+        problems.append(QString("%1 цепочек вместо %2").arg(strips.CountStrips()).arg(expected));
+    }
+    return problems;
+}
+
+QJsonObject loadTimings(QString const& path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+bool saveJson(QString const& path, QJsonObject const& object)
+{
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qWarning().noquote() << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(object).toJson());
+    return true;
+}
+}
+
+double Regression::Compare(QImage const& actual, QImage const& golden, int tolerance, QImage* diff)
+{
+    if (actual.size() != golden.size())
+    {
+        return 1;
+    }
+    QImage a = actual.convertToFormat(QImage::Format_ARGB32);
+    QImage b = golden.convertToFormat(QImage::Format_ARGB32);
+    if (diff)
+    {
+        *diff = b;
+    }
+    qint64 different = 0;
+    for (int y = 0; y < a.height(); ++y)
+    {
+        const QRgb* rowA = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+        const QRgb* rowB = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x)
+        {
+            int delta = std::max({std::abs(qRed(rowA[x]) - qRed(rowB[x])), std::abs(qGreen(rowA[x]) - qGreen(rowB[x])),
+                                  std::abs(qBlue(rowA[x]) - qBlue(rowB[x])), std::abs(qAlpha(rowA[x]) - qAlpha(rowB[x]))});
+            if (delta > tolerance)
+            {
+                ++different;
+                if (diff)
+                {
+                    reinterpret_cast<QRgb*>(diff->scanLine(y))[x] = qRgb(255, 0, 0);
+                }
+            }
+        }
+    }
+    return double(different) / (qint64(a.width()) * a.height());
+}
+
+int Regression::Run(QStringList const& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Проверка отрисовки по эталонным изображениям");
+    parser.addHelpOption();
+    QCommandLineOption regressionOption("regression", "Каталог с эталонными изображениями и временами.", "directory");
+    QCommandLineOption updateOption("update", "Перезаписать эталоны текущей отрисовкой.");
+    QCommandLineOption outputOption("output", "Каталог для отчёта и отличающихся изображений.", "directory", "regression");
+    QCommandLineOption toleranceOption("tolerance", "Допустимое отличие канала цвета, 0-255.", "value", "24");
+    QCommandLineOption pixelsOption("max-diff", "Допустимая доля отличающихся пикселей, %.", "percent", "0.1");
+    QCommandLineOption slowdownOption("max-slowdown", "Допустимое замедление относительно эталона, раз.", "factor", "1.5");
+    parser.addOption(regressionOption);
+    parser.addOption(updateOption);
+    parser.addOption(outputOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(pixelsOption);
+    parser.addOption(slowdownOption);
+    parser.process(arguments);
+
+    Options options;
+    options.goldenDirectory = parser.value(regressionOption);
+    options.outputDirectory = parser.value(outputOption);
+    options.update = parser.isSet(updateOption);
+    options.channelTolerance = parser.value(toleranceOption).toInt();
+    options.maxDifferentPixels = parser.value(pixelsOption).toDouble() / 100;
+    options.maxSlowdown = parser.value(slowdownOption).toDouble();
+    if (options.goldenDirectory.isEmpty() || !QDir().mkpath(options.goldenDirectory) || !QDir().mkpath(options.outputDirectory))
+    {
+        qWarning().noquote() << "Использование: Lab6 --regression <каталог эталонов> [--update] [--output <каталог>]"
+                                " [--tolerance 0-255] [--max-diff %] [--max-slowdown раз]";
+        return 1;
+    }
+
+    QDir golden(options.goldenDirectory);
+    QDir output(options.outputDirectory);
+    // An empty directory would fail every case one by one; the goldens have
+    // to be written once by a trusted build before anything can be compared.
+    if (!options.update && golden.entryList({"*.png"}, QDir::Files).isEmpty())
+    {
+        qWarning().noquote() << golden.path() << ": нет эталонов; запишите их эталонной сборкой:"
+                             << "Lab6 --regression" << golden.path() << "--update";
+        return 1;
+    }
+    QJsonObject goldenTimings = loadTimings(golden.filePath("timings.json"));
+    QJsonObject timings;
+    QJsonArray results;
+    int failures = 0;
+    for (ModelSpec const& model : models)
+    {
+        // Ordered once per model rather than by every case's SetMesh.
+        Mesh mesh = model.build().ToStrips();
+        for (TransformSpec const& transform : transforms)
+        {
+            for (AngleSpec const& angle : angles)
+            {
+                for (ProjectionSpec const& projection : projections)
+                {
+                    QString name = QString("%1_%2_%3_%4").arg(QLatin1String(model.name), QLatin1String(transform.name), QLatin1String(angle.name), QLatin1String(projection.name));
+                    Renderer renderer;
+                    renderer.SetStripMesh(mesh);
+                    renderer.TransformFigure(transform.build());
+                    if (!angle.useDefault)
+                    {
+                        renderer.SetRotation(angle.angleX, angle.angleY, angle.angleZ);
+                    }
+                    renderer.SetProjection(projection.projection);
+                    renderer.SetUnit(std::min(imageSize.width(), imageSize.height()) / 20);
+                    double ms = 0;
+                    QImage image = renderCase(renderer, ms);
+                    timings[name] = ms;
+
+                    QJsonObject result;
+                    result["name"] = name;
+                    result["ms"] = ms;
+                    QString goldenPath = golden.filePath(name + ".png");
+                    if (options.update)
+                    {
+                        if (!image.save(goldenPath))
+                        {
+                            qWarning().noquote() << goldenPath << ": не удалось записать";
+                            ++failures;
+                        }
+                        results.append(result);
+                        continue;
+                    }
+
+                    QStringList problems;
+                    QImage expected(goldenPath);
+                    if (expected.isNull())
+                    {
+                        problems.append("нет эталона");
+                    }
+                    else
+                    {
+                        QImage diff;
+                        double different = Compare(image, expected, options.channelTolerance, &diff);
+                        result["different_pixels"] = different;
+                        if (different > options.maxDifferentPixels)
+                        {
+                            problems.append(QString("отличается %1% пикселей").arg(different * 100, 0, 'f', 3));
+                            image.save(output.filePath(name + ".png"));
+                            diff.save(output.filePath(name + "_diff.png"));
+                        }
+                    }
+                    if (goldenTimings.contains(name))
+                    {
+                        double baseline = goldenTimings[name].toDouble();
+                        result["baseline_ms"] = baseline;
+                        if (ms > baseline * options.maxSlowdown && ms - baseline > options.minSlowdownMs)
+                        {
+                            problems.append(QString("%1 мс против %2 мс").arg(ms, 0, 'f', 2).arg(baseline, 0, 'f', 2));
+                        }
+                    }
+                    result["passed"] = problems.isEmpty();
+                    results.append(result);
+                    if (!problems.isEmpty())
+                    {
+                        qWarning().noquote() << name << ":" << problems.join(", ");
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    // Strip ordering: the edge multiset is kept and the chain count is the
+    // minimum, on the models above and on random multigraphs.
+    std::mt19937 random(44);
+    std::vector<std::pair<QString, Mesh>> stripCases;
+    for (ModelSpec const& model : models)
+    {
+        stripCases.emplace_back(QLatin1String(model.name), model.build());
+    }
+    for (int i = 0; i < stripGraphs; ++i)
+    {
+        stripCases.emplace_back(QString("graph%1").arg(i), randomMultigraph(random));
+    }
+    for (auto const& stripCase : stripCases)
+    {
+        QString name = "strips_" + stripCase.first;
+        QStringList problems = checkStrips(stripCase.second);
+        QJsonObject result;
+        result["name"] = name;
+        result["passed"] = problems.isEmpty();
+        results.append(result);
+        if (!problems.isEmpty())
+        {
+            qWarning().noquote() << name << ":" << problems.join(", ");
+            ++failures;
+        }
+    }
+
+    if (options.update)
+    {
+        saveJson(golden.filePath("timings.json"), timings);
+        qInfo().noquote() << "Эталоны записаны в" << golden.path();
+        return failures == 0 ? 0 : 1;
+    }
+    QJsonObject report;
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["cases"] = results;
+    report["failures"] = failures;
+    saveJson(output.filePath("regression.json"), report);
+    qInfo().noquote() << QString("Случаев: %1, не прошли: %2").arg(results.size()).arg(failures);
+    return failures == 0 ? 0 : 1;
+}
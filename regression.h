@@ -0,0 +1,28 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+
+class Regression
+{
+public:
+    struct Options
+    {
+        QString goldenDirectory;
+        QString outputDirectory = "regression";
+        bool update = false;
+        int channelTolerance = 24;
+        double maxDifferentPixels = 0.001;
+        double maxSlowdown = 1.5;
+        double minSlowdownMs = 0.5;
+    };
+    // Fraction of pixels whose largest channel difference exceeds tolerance;
+    // images of different sizes differ completely. Differing pixels are
+    // marked red in diff when it is given.
+    static double Compare(QImage const& actual, QImage const& golden, int tolerance, QImage* diff = nullptr);
+    static int Run(QStringList const& arguments);
+};
+
+#endif // REGRESSION_H
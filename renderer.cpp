@@ -0,0 +1,1268 @@
+#include "renderer.h"
+#include <QPainterPath>
+#include <QElapsedTimer>
+#include <QFontMetrics>
+#include "projection.h"
+#include "trace.h"
+#include "allocationcounter.h"
+
+Renderer::Renderer():
+    AksonometricMatrix(Matrix::GetAksonometricMatrix(frame().angleX, frame().angleY, frame().angleZ))
+{
+    axis.assign(3, Point(0, 0, 0));
+    recalculateAxis();
+    recalculateStyle();
+}
+
+void Renderer::Render(QPainter& pt, QSize size)
+{
+    TRACE_SCOPE("paint", "Render");
+    QElapsedTimer timer;
+    timer.start();
+    AllocationCounter::Counts before = AllocationCounter::GetCounts();
+    PrepareFrame(size);
+    Draw(pt, size);
+
+    QualityStats& stats = qualityStats[static_cast<int>(frame().quality)];
+    stats.lastMs = timer.nsecsElapsed() / 1e6;
+    stats.totalMs += stats.lastMs;
+    stats.frames++;
+    frameAllocations = AllocationCounter::GetCounts() - before;
+}
+
+void Renderer::Draw(QPainter& pt, QSize size)
+{
+    TRACE_SCOPE("paint", "draw");
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Painter);
+    pt.setRenderHint(QPainter::RenderHint::Antialiasing, frame().quality == Quality::Refined);
+    if (!frame().multiView)
+    {
+        setViewport(QRect(QPoint(0, 0), size));
+        drawBox(pt);
+        drawAxis(pt);
+        drawTicks(pt);
+        drawArrows(pt);
+        drawFigure(pt, 0);
+        drawSelection(pt);
+    }
+    else
+    {
+        int w = size.width() / 2;
+        int h = size.height() / 2;
+        for (int i = 0; i < 4; ++i)
+        {
+            setViewport(QRect((i % 2) * w, (i / 2) * h, w, h));
+            pt.save();
+            pt.setClipRect(QRect(viewX, viewY, viewWidth, viewHeight));
+            drawBox(pt);
+            drawAxis(pt);
+            drawTicks(pt);
+            drawArrows(pt);
+            drawFigure(pt, i);
+            pt.restore();
+        }
+        drawSelection(pt);
+    }
+    peakGeometryBytes = std::max(peakGeometryBytes, GetGeometryBytes());
+}
+
+void Renderer::PrepareFrame(QSize size)
+{
+    TRACE_SCOPE("paint", "PrepareFrame");
+    AllocationCounter::Scope allocations(AllocationCounter::Subsystem::Geometry);
+    ViewState const& s = state.Read();
+    arena.Reset();
+    frameMesh = s.mesh;
+    if (!s.deformation.IsIdentity() && s.HasGeometry())
+    {
+        // Deformed once per frame into a buffer that keeps its capacity;
+        // every view and instance then projects these vertices.
+        deformedVertices.resize(s.mesh.GetVertexCount());
+        s.deformation.Apply(s.mesh, deformedVertices.data());
+        frameMesh = Mesh::FromBuffers(deformedVertices.data(), Mesh::VertexFormat::Float, Mesh::Quantization(),
+                                      deformedVertices.size(), s.mesh.GetEdges(), s.mesh.GetEdgeCount(), nullptr);
+    }
+    AksonometricMatrix = Matrix::GetAksonometricMatrix(s.angleX, s.angleY, s.angleZ);
+    recalculateAxisCache();
+    for (Polylines& lines : figureLines)
+    {
+        lines.Clear();
+    }
+    edgeStride = 1;
+    // In point-cloud mode the stride and the budget count vertices.
+    size_t budget = s.pointCloud ? preview_point_budget : preview_edge_budget;
+    if (s.quality == Quality::Preview && budget > 0)
+    {
+        size_t items = (s.pointCloud ? s.mesh.GetVertexCount() : s.mesh.GetEdgeCount())
+                     * std::max<size_t>(s.instances->size(), 1) * (s.multiView ? 4 : 1);
+        edgeStride = std::max<size_t>((items + budget - 1) / budget, 1);
+    }
+    if (s.pointCloud)
+    {
+        splatter.Begin(size);
+    }
+    if (s.HasGeometry())
+    {
+        // One instance's vertices at a time, reused by every instance and
+        // view; the buffers keep their capacity across frames. The world
+        // buffer serves perspective and the four views.
+        size_t count = frameMesh.GetVertexCount();
+        bool perspective = !s.multiView && s.projection == static_cast<int>(Matrix::ProjectionType::ProjectionPerspective);
+        if (!s.pointCloud)
+        {
+            screenVertices.resize(count);
+        }
+        if (s.multiView || (perspective && !s.pointCloud))
+        {
+            worldVertices.resize(count, Point(0, 0, 0));
+        }
+        if (perspective && !s.pointCloud)
+        {
+            projectedVertices.resize(count, Point(0, 0, 0));
+            visibleVertices.resize(count);
+        }
+    }
+    if (!s.multiView)
+    {
+        setViewport(QRect(QPoint(0, 0), size));
+        prepareFigure();
+        prepareSelection();
+        return;
+    }
+
+    Matrix model = s.GetModelMatrix();
+    FrameVector<Matrix> transforms(s.HasGeometry() ? std::max<size_t>(s.instances->size(), 1) : 0, model, arena.Resource());
+    if (s.HasGeometry() && !s.instances->empty())
+    {
+        Matrix::ComposeBatch(model, s.instances->data(), s.instances->size(), transforms.data());
+    }
+    const int dropAxes[4] = {2, 0, 1, -1};
+    int w = size.width() / 2;
+    int h = size.height() / 2;
+    // Each view maps world coordinates to its viewport: two scaled columns
+    // for the orthographic views, three for the axonometric one.
+    FrameVector<Matrix> selections(arena.Resource());
+    FrameVector<PointSplatter::View> splatViews(arena.Resource());
+    Matrix identity = Matrix::GetIdentityMatrix();
+    for (int i = 0; i < 4; ++i)
+    {
+        setViewport(QRect((i % 2) * w, (i / 2) * h, w, h));
+        selections.push_back(screenMatrix(identity, dropAxes[i]));
+        if (s.pointCloud)
+        {
+            splatViews.push_back(parallelView(selections.back(), identity, dropAxes[i]));
+        }
+    }
+    // The model is transformed once per instance; the views only select
+    // from the shared world buffer.
+    for (Matrix const& transform : transforms)
+    {
+        frameMesh.TransformVertices(transform, worldVertices.data());
+        for (int i = 0; i < 4; ++i)
+        {
+            if (s.pointCloud)
+            {
+                splatter.Splat(worldVertices.data(), worldVertices.size(), splatViews[i]);
+            }
+            else
+            {
+                appendWorld(figureLines[i], selections[i], dropAxes[i]);
+            }
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        setViewport(QRect((i % 2) * w, (i / 2) * h, w, h));
+        figureLines[i].Finish();
+        if (s.pointCloud)
+        {
+            splatter.Resolve(QRect(viewX, viewY, viewWidth, viewHeight));
+        }
+    }
+    prepareSelection();
+}
+
+void Renderer::recalculateAxis()
+{
+    const Point units[3] = {Point(1, 0, 0), Point(0, 1, 0), Point(0, 0, 1)};
+    AksonometricMatrix.TransformPoints(units, 3, axis.data());
+}
+
+void Renderer::recalculateStyle()
+{
+    figurePen = QPen(Qt::black, line_width);
+    selectionPen = QPen(Qt::red, line_width + 2);
+    selectionBrush = QBrush(Qt::red);
+    boxPen = QPen(boxColor);
+    boxPen.setWidth(box_width);
+    const QColor colors[3] = {XColor, YColor, ZColor};
+    for (int k = 0; k < 3; ++k)
+    {
+        axisPens[k] = QPen(colors[k]);
+        axisPens[k].setWidth(axis_width);
+    }
+    unitPen = QPen(axisColor);
+    unitPen.setWidth(axis_width);
+    axisBrush = QBrush(axisColor);
+    labelFont = QFont();
+    labelFont.setPixelSize(12);
+    labelFontKey = labelFont.key();
+    labelHeight = QFontMetrics(labelFont).height();
+    tickTexts.clear();
+    for (int i = -axis_length; i <= axis_length; ++i)
+    {
+        tickTexts.push_back(QString::number(i));
+    }
+}
+
+QStaticText const& Renderer::label(QString const& text)
+{
+    QPair<QString, QString> key(labelFontKey, text);
+    auto found = labelCache.find(key);
+    if (found != labelCache.end())
+    {
+        return *found;
+    }
+    QStaticText laidOut(text);
+    laidOut.setTextFormat(Qt::PlainText);
+    laidOut.setPerformanceHint(QStaticText::AggressiveCaching);
+    laidOut.prepare(QTransform(), labelFont);
+    return *labelCache.insert(key, laidOut);
+}
+
+void Renderer::drawLabel(QPainter& p, QPointF center, QString const& text)
+{
+    QStaticText const& laidOut = label(text);
+    QSizeF size = laidOut.size();
+    p.drawStaticText(center - QPointF(size.width() / 2, size.height() / 2), laidOut);
+}
+
+void Renderer::recalculateAxisCache()
+{
+    ViewState const& s = frame();
+    if (axisCache.angleX == s.angleX && axisCache.angleY == s.angleY && axisCache.angleZ == s.angleZ && axisCache.unit == s.u)
+    {
+        return;
+    }
+    recalculateAxis();
+    axisCache.angleX = s.angleX;
+    axisCache.angleY = s.angleY;
+    axisCache.angleZ = s.angleZ;
+    axisCache.unit = s.u;
+
+    axisCache.axes[0] = QLineF(adjust(Point(-axis_length, 0, 0)), adjust(Point(axis_length, 0, 0)));
+    axisCache.axes[1] = QLineF(adjust(Point(0, -axis_length, 0)), adjust(Point(0, axis_length, 0)));
+    axisCache.axes[2] = QLineF(adjust(Point(0, 0, -axis_length)), adjust(Point(0, 0, axis_length)));
+    axisCache.units[0] = QLineF(QPointF(0, 0), adjust({1, 0, 0}));
+    axisCache.units[1] = QLineF(QPointF(0, 0), adjust({0, 1, 0}));
+    axisCache.units[2] = QLineF(QPointF(0, 0), adjust({0, 0, 1}));
+
+    axisCache.ticks.clear();
+    axisCache.tickLabels.clear();
+    // Label every tick when the unit leaves room for the text, otherwise
+    // every n-th one.
+    int labelStep = std::max(1, (labelHeight + s.u - 1) / std::max(s.u, 1));
+    for (int i = 1; i <= axis_length; ++i)
+    {
+        axisCache.ticks.push_back(QLineF(adjust(Point(i, 0, -tick_length / 2)), adjust(Point(i, 0, tick_length / 2))));
+        axisCache.ticks.push_back(QLineF(adjust(Point(-i, 0, -tick_length / 2)), adjust(Point(-i, 0, tick_length / 2))));
+        if (i % labelStep == 0)
+        {
+            axisCache.tickLabels.push_back({adjust(Point(i, 0, tick_length)), i});
+            axisCache.tickLabels.push_back({adjust(Point(-i, 0, tick_length)), -i});
+        }
+    }
+    for (int i = 1; i <= axis_length; ++i)
+    {
+        axisCache.ticks.push_back(QLineF(adjust(Point(0, i, -tick_length / 2)), adjust(Point(0, i, tick_length / 2))));
+        axisCache.ticks.push_back(QLineF(adjust(Point(0, -i, -tick_length / 2)), adjust(Point(0, -i, tick_length / 2))));
+        if (i % labelStep == 0)
+        {
+            axisCache.tickLabels.push_back({adjust(Point(0, i, tick_length)), i});
+            axisCache.tickLabels.push_back({adjust(Point(0, -i, tick_length)), -i});
+        }
+    }
+    for (int i = 1; i <= axis_length; ++i)
+    {
+        axisCache.ticks.push_back(QLineF(adjust(Point(-tick_length / 2, 0, i)), adjust(Point(tick_length / 2, 0, i))));
+        axisCache.ticks.push_back(QLineF(adjust(Point(-tick_length / 2, 0, -i)), adjust(Point(tick_length / 2, 0, -i))));
+        if (i % labelStep == 0)
+        {
+            axisCache.tickLabels.push_back({adjust(Point(tick_length, 0, i)), i});
+            axisCache.tickLabels.push_back({adjust(Point(tick_length, 0, -i)), -i});
+        }
+    }
+
+    const Point tips[3][4] = {
+        {Point(axis_length, 0, -tick_length / 2), Point(axis_length + 1, 0, 0), Point(axis_length, 0, tick_length / 2), Point(axis_length + 1.5, 1, 0)},
+        {Point(0, axis_length, -tick_length / 2), Point(0, axis_length + 1, 0), Point(0, axis_length, tick_length / 2), Point(0, axis_length + 1.5, 0)},
+        {Point(-tick_length / 2, 0, axis_length), Point(0, 0, axis_length + 1), Point(tick_length / 2, 0, axis_length), Point(0, 1, axis_length + 1.5)},
+    };
+    for (int k = 0; k < 3; ++k)
+    {
+        axisCache.arrows[k].clear();
+        axisCache.arrows[k].moveTo(adjust(tips[k][0]));
+        axisCache.arrows[k].lineTo(adjust(tips[k][1]));
+        axisCache.arrows[k].lineTo(adjust(tips[k][2]));
+        axisCache.arrows[k].lineTo(adjust(tips[k][0]));
+        axisCache.labels[k] = adjust(tips[k][3]);
+    }
+}
+
+void Renderer::setViewport(QRect viewport)
+{
+    viewX = viewport.x();
+    viewY = viewport.y();
+    viewWidth = viewport.width();
+    viewHeight = viewport.height();
+    zx = viewX + viewWidth / 2 + qRound(frame().pan.x() * frame().u);
+    zy = viewY + viewHeight / 2 + qRound(frame().pan.y() * frame().u);
+}
+Matrix Renderer::ViewState::GetModelMatrix() const
+{
+    TRACE_SCOPE("transform", "GetModelMatrix");
+    return AnimationMatrix * PreviewMatrix * TransformationMatrix;
+}
+bool Renderer::ViewState::HasGeometry() const
+{
+    return pointCloud ? mesh.GetVertexCount() > 0 : !mesh.IsEmpty();
+}
+
+Matrix Renderer::GetModelMatrix() const
+{
+    return state.Current().GetModelMatrix();
+}
+Renderer::ViewState const& Renderer::frame() const
+{
+    return state.Front();
+}
+QPointF Renderer::Adjust(const Point& _p)
+{
+    return QPointF(zx, zy) + adjust(_p);
+}
+QPointF Renderer::adjust(const Point& _p, int dropAxis) const
+{
+    ViewState const& s = frame();
+    QPointF p;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (k != dropAxis)
+        {
+            p += axis[k].toQPoint() * _p.getParameter(k);
+        }
+    }
+    return QPointF(p.x() * s.u, -p.y() * s.u);
+}
+void Renderer::drawBox(QPainter& p)
+{
+    int h = viewHeight - 2 * box_offset;
+    int w = viewWidth - 2 * box_offset;
+    p.setPen(boxPen);
+    p.drawRect(viewX + box_offset, viewY + box_offset, w, h);
+}
+void Renderer::drawGrid(QPainter& p)
+{
+    ViewState const& s = frame();
+    QPen gridPen(gridColor);
+    gridPen.setWidth(1);
+    p.setPen(gridPen);
+    int i = 0;
+    while(zx + i * s.u <= viewX + viewWidth - box_offset)
+    {
+        i++;
+        p.drawLine(zx + i * s.u, box_offset, zx + i * s.u, viewHeight - box_offset);
+        p.drawLine(zx - i * s.u, box_offset, zx - i * s.u, viewHeight - box_offset);
+    }
+    i = 0;
+    while(zy + i * s.u < viewHeight)
+    {
+        i++;
+        p.drawLine(box_offset, zy + i * s.u, viewWidth - box_offset, zy + i * s.u);
+        p.drawLine(box_offset, zy - i * s.u, viewWidth - box_offset, zy - i * s.u);
+    }
+}
+
+void Renderer::drawAxis(QPainter& p)
+{
+    p.save();
+    p.translate(zx, zy);
+    for (int k = 0; k < 3; ++k)
+    {
+        p.setPen(axisPens[k]);
+        p.drawLine(axisCache.axes[k]);
+    }
+
+    p.setPen(unitPen);
+    p.drawLines(axisCache.units, 3);
+    p.restore();
+}
+
+void Renderer::drawTicks(QPainter& p)
+{
+    p.setPen(unitPen);
+    p.setFont(labelFont);
+
+    QStaticText const& zero = label(tickTexts[axis_length]);
+    p.drawStaticText(QPointF(zx - zero.size().width() - pixel_width, zy + pixel_width), zero);
+    p.save();
+    p.translate(zx, zy);
+    p.drawLines(axisCache.ticks.data(), axisCache.ticks.size());
+    for (TickLabel const& tick : axisCache.tickLabels)
+    {
+        drawLabel(p, tick.position, tickTexts[tick.value + axis_length]);
+    }
+    p.restore();
+}
+
+void Renderer::drawArrows(QPainter& p)
+{
+    static const QString names[3] = {QStringLiteral("X"), QStringLiteral("Y"), QStringLiteral("Z")};
+    p.setBrush(axisBrush);
+
+    p.save();
+    p.setRenderHint(QPainter::RenderHint::Antialiasing);
+    p.translate(zx, zy);
+    for (int k = 0; k < 3; ++k)
+    {
+        p.drawPath(axisCache.arrows[k]);
+        drawLabel(p, axisCache.labels[k], names[k]);
+    }
+    p.restore();
+}
+
+void Renderer::drawFigure(QPainter& p, int view)
+{
+    if (frame().pointCloud)
+    {
+        QRect viewport(viewX, viewY, viewWidth, viewHeight);
+        p.drawImage(viewport, splatter.GetImage(), viewport);
+        return;
+    }
+    Polylines const& lines = figureLines[view];
+    p.setPen(figurePen);
+    p.setBrush(Qt::NoBrush);
+    p.drawLines(lines.segments.data(), static_cast<int>(lines.segments.size()));
+    const QPointF* points = lines.points.data();
+    for (int count : lines.counts)
+    {
+        p.drawPolyline(points, count);
+        points += count;
+    }
+}
+
+void Renderer::prepareFigure()
+{
+    TRACE_SCOPE("paint", "prepareFigure");
+    ViewState const& s = frame();
+    if (!s.HasGeometry())
+    {
+        return;
+    }
+    Matrix view = s.GetModelMatrix();
+    if (s.instances->empty())
+    {
+        if (s.pointCloud)
+        {
+            splatInstance(view);
+        }
+        else
+        {
+            appendInstance(figureLines[0], view);
+        }
+    }
+    else
+    {
+        FrameVector<Matrix> transforms(s.instances->size(), view, arena.Resource());
+        Matrix::ComposeBatch(view, s.instances->data(), s.instances->size(), transforms.data());
+        for (Matrix const& transform : transforms)
+        {
+            if (!isInstanceVisible(transform))
+            {
+                continue;
+            }
+            if (s.pointCloud)
+            {
+                splatInstance(transform);
+            }
+            else
+            {
+                appendInstance(figureLines[0], transform);
+            }
+        }
+    }
+    figureLines[0].Finish();
+    if (s.pointCloud)
+    {
+        splatter.Resolve(QRect(viewX, viewY, viewWidth, viewHeight));
+    }
+}
+
+void Renderer::appendInstance(Polylines& lines, Matrix const& transform)
+{
+    ViewState const& s = frame();
+    switch (static_cast<Matrix::ProjectionType>(s.projection))
+    {
+    case Matrix::ProjectionType::ProjectionPerspective:
+        frameMesh.TransformVertices(transform, worldVertices.data());
+        appendPerspective(lines, worldVertices.data());
+        break;
+    case Matrix::ProjectionType::ProjectionCavalier:
+    case Matrix::ProjectionType::ProjectionCabinet:
+        appendScreen(lines, screenMatrix(Matrix::GetObliqueMatrix(Projection::GetDepthScale(s.projection), s.oblique_angle) * transform, -1));
+        break;
+    default:
+        appendScreen(lines, screenMatrix(transform, Projection::GetDroppedAxis(s.projection)));
+    }
+}
+
+// Folds the axis directions, the unit, the y flip and the viewport centre
+// into the model transform, so one 2x4 product per vertex replaces
+// TransformVertices followed by adjust().
+Matrix Renderer::screenMatrix(Matrix const& model, int dropAxis) const
+{
+    ViewState const& s = frame();
+    double values[8] = {};
+    for (int k = 0; k < 3; ++k)
+    {
+        if (k != dropAxis)
+        {
+            QPointF direction = axis[k].toQPoint();
+            values[k] = direction.x() * s.u;
+            values[4 + k] = -direction.y() * s.u;
+        }
+    }
+    Matrix screen = Matrix::FromValues(2, 4, values) * model;
+    for (int c = 0; c < 4; ++c)
+    {
+        values[c] = screen.getElement(0, c);
+        values[4 + c] = screen.getElement(1, c);
+    }
+    values[3] += zx;
+    values[7] += zy;
+    return Matrix::FromValues(2, 4, values);
+}
+
+// The point-cloud counterpart of appendInstance.
+void Renderer::splatInstance(Matrix const& transform)
+{
+    ViewState const& s = frame();
+    switch (static_cast<Matrix::ProjectionType>(s.projection))
+    {
+    case Matrix::ProjectionType::ProjectionPerspective:
+        splatter.Splat(frameMesh, perspectiveView(transform));
+        break;
+    case Matrix::ProjectionType::ProjectionCavalier:
+    case Matrix::ProjectionType::ProjectionCabinet:
+    {
+        Matrix oblique = Matrix::GetObliqueMatrix(Projection::GetDepthScale(s.projection), s.oblique_angle);
+        splatter.Splat(frameMesh, parallelView(screenMatrix(oblique * transform, -1), transform, 2));
+        break;
+    }
+    default:
+    {
+        int dropAxis = Projection::GetDroppedAxis(s.projection);
+        splatter.Splat(frameMesh, parallelView(screenMatrix(transform, dropAxis), transform, dropAxis));
+    }
+    }
+}
+
+// screen's two rows plus a depth row that grows away from the viewer: the
+// viewer looks down depthAxis from its positive side, or with depthAxis -1
+// along the axonometric view direction.
+PointSplatter::View Renderer::parallelView(Matrix const& screen, Matrix const& model, int depthAxis) const
+{
+    PointSplatter::View view;
+    for (int c = 0; c < 4; ++c)
+    {
+        view.rows[c] = screen.getElement(0, c);
+        view.rows[4 + c] = screen.getElement(1, c);
+        for (int k = 0; k < 3; ++k)
+        {
+            double toward = depthAxis < 0 ? axis[k].getParameter(2) : (k == depthAxis ? 1 : 0);
+            view.rows[8 + c] -= toward * model.getElement(k, c);
+        }
+    }
+    view.clip = QRect(viewX, viewY, viewWidth, viewHeight);
+    view.stride = edgeStride;
+    return view;
+}
+
+// The same mapping as appendPerspective: Projection::Perspective on the
+// world point, then adjust() without depth, around the view centre.
+PointSplatter::View Renderer::perspectiveView(Matrix const& model) const
+{
+    ViewState const& s = frame();
+    PointSplatter::View view;
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            view.rows[4 * r + c] = model.getElement(r, c);
+        }
+    }
+    view.focalLength = s.focalLength;
+    view.nearDistance = s.nearDistance;
+    view.screen[0] = axis[0].getParameter(0) * s.u;
+    view.screen[1] = axis[1].getParameter(0) * s.u;
+    view.screen[2] = -axis[0].getParameter(1) * s.u;
+    view.screen[3] = -axis[1].getParameter(1) * s.u;
+    view.center = QPointF(zx, zy);
+    view.clip = QRect(viewX, viewY, viewWidth, viewHeight);
+    view.stride = edgeStride;
+    return view;
+}
+
+void Renderer::appendScreen(Polylines& lines, Matrix const& screen)
+{
+    frameMesh.ProjectVertices(screen, screenVertices.data());
+    appendEdges(lines, screenVertices.data());
+}
+
+// worldVertices through select, a screenMatrix of the identity whose
+// dropAxis column is zero and skipped.
+void Renderer::appendWorld(Polylines& lines, Matrix const& select, int dropAxis)
+{
+    const Point* world = worldVertices.data();
+    QPointF* points = screenVertices.data();
+    size_t count = worldVertices.size();
+    int columns[3];
+    int used = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (k != dropAxis)
+        {
+            columns[used++] = k;
+        }
+    }
+    double x0 = select.getElement(0, columns[0]), x1 = select.getElement(0, columns[1]);
+    double y0 = select.getElement(1, columns[0]), y1 = select.getElement(1, columns[1]);
+    double dx = select.getElement(0, 3), dy = select.getElement(1, 3);
+    if (used == 2)
+    {
+        for (size_t v = 0; v < count; ++v)
+        {
+            double a = world[v].getParameter(columns[0]);
+            double b = world[v].getParameter(columns[1]);
+            points[v] = QPointF(x0 * a + x1 * b + dx, y0 * a + y1 * b + dy);
+        }
+    }
+    else
+    {
+        double x2 = select.getElement(0, 2), y2 = select.getElement(1, 2);
+        for (size_t v = 0; v < count; ++v)
+        {
+            double a = world[v].getParameter(0);
+            double b = world[v].getParameter(1);
+            double c = world[v].getParameter(2);
+            points[v] = QPointF(x0 * a + x1 * b + x2 * c + dx, y0 * a + y1 * b + y2 * c + dy);
+        }
+    }
+    appendEdges(lines, points);
+}
+
+void Renderer::appendEdges(Polylines& lines, const QPointF* points)
+{
+    int last = -1;
+    const Edge* edges = frameMesh.GetEdges();
+    for (size_t i = 0; i < frameMesh.GetEdgeCount(); i += edgeStride)
+    {
+        const Edge& e = edges[i];
+        if (e.a != last)
+        {
+            lines.MoveTo(points[e.a]);
+        }
+        lines.LineTo(points[e.b]);
+        last = e.b;
+    }
+}
+
+void Renderer::appendPerspective(Polylines& lines, const Point* world)
+{
+    ViewState const& s = frame();
+    size_t count = frameMesh.GetVertexCount();
+    Point* projected = projectedVertices.data();
+    char* visible = visibleVertices.data();
+    std::copy(world, world + count, projected);
+    Projection::Perspective(projected, count, visible, s.focalLength, s.nearDistance);
+    QPointF center(zx, zy);
+    int last = -1;
+    const Edge* edges = frameMesh.GetEdges();
+    for (size_t i = 0; i < frameMesh.GetEdgeCount(); i += edgeStride)
+    {
+        const Edge& e = edges[i];
+        if (visible[e.a] && visible[e.b])
+        {
+            if (e.a != last)
+            {
+                lines.MoveTo(center + adjust(projected[e.a]));
+            }
+            lines.LineTo(center + adjust(projected[e.b]));
+            last = e.b;
+            continue;
+        }
+        last = -1;
+        Point a = world[e.a];
+        Point b = world[e.b];
+        if (Projection::ClipToNearPlane(a, b, s.focalLength, s.nearDistance))
+        {
+            lines.MoveTo(center + adjust(Projection::PerspectivePoint(a, s.focalLength)));
+            lines.LineTo(center + adjust(Projection::PerspectivePoint(b, s.focalLength)));
+        }
+    }
+}
+
+bool Renderer::projectPoint(Point const& world, QPointF& screen)
+{
+    ViewState const& s = frame();
+    if (s.multiView)
+    {
+        screen = Adjust(world);
+        return true;
+    }
+    Point point = world;
+    switch (static_cast<Matrix::ProjectionType>(s.projection))
+    {
+    case Matrix::ProjectionType::ProjectionPerspective:
+    {
+        char visible;
+        Projection::Perspective(&point, 1, &visible, s.focalLength, s.nearDistance);
+        if (!visible)
+        {
+            return false;
+        }
+        screen = Adjust(point);
+        return true;
+    }
+    case Matrix::ProjectionType::ProjectionCavalier:
+    case Matrix::ProjectionType::ProjectionCabinet:
+        Projection::Oblique(&point, 1, Projection::GetDepthScale(s.projection), s.oblique_angle);
+        screen = Adjust(point);
+        return true;
+    default:
+        screen = QPointF(zx, zy) + adjust(world, Projection::GetDroppedAxis(s.projection));
+        return true;
+    }
+}
+
+void Renderer::prepareSelection()
+{
+    TRACE_SCOPE("paint", "prepareSelection");
+    ViewState const& s = frame();
+    selectionVisible = false;
+    if (s.selectedEdge < 0)
+    {
+        return;
+    }
+    Matrix transform = s.GetModelMatrix();
+    if (s.selectedInstance >= 0)
+    {
+        transform = transform * (*s.instances)[s.selectedInstance];
+    }
+    const Edge& e = frameMesh.GetEdges()[s.selectedEdge];
+    const Point local[2] = {frameMesh.GetVertex(e.a), frameMesh.GetVertex(e.b)};
+    Point ends[2] = {local[0], local[1]};
+    transform.TransformPoints(local, 2, ends);
+    if (!projectPoint(ends[0], selectionEnds[0]) || !projectPoint(ends[1], selectionEnds[1]))
+    {
+        return;
+    }
+    selectionVisible = true;
+    selectionVertexEnd = s.selectedVertex < 0 ? -1 : s.selectedVertex == e.a ? 0 : 1;
+}
+
+void Renderer::drawSelection(QPainter& p)
+{
+    if (!selectionVisible)
+    {
+        return;
+    }
+    p.setPen(selectionPen);
+    p.drawLine(selectionEnds[0], selectionEnds[1]);
+    if (selectionVertexEnd >= 0)
+    {
+        p.setBrush(selectionBrush);
+        p.drawEllipse(selectionEnds[selectionVertexEnd], line_width + 2, line_width + 2);
+    }
+}
+
+bool Renderer::isInstanceVisible(Matrix const& transform)
+{
+    ViewState const& s = frame();
+    Point corners[8] = {s.bounds[0], s.bounds[1], s.bounds[2], s.bounds[3], s.bounds[4], s.bounds[5], s.bounds[6], s.bounds[7]};
+    transform.TransformPoints(s.bounds.data(), s.bounds.size(), corners);
+    double left = INFINITY, right = -INFINITY, top = INFINITY, bottom = -INFINITY;
+    for (const Point& corner : corners)
+    {
+        QPointF c;
+        if (!projectPoint(corner, c))
+        {
+            return true;
+        }
+        left = std::min(left, c.x());
+        right = std::max(right, c.x());
+        top = std::min(top, c.y());
+        bottom = std::max(bottom, c.y());
+    }
+    QRectF box(QPointF(left, top), QPointF(right, bottom));
+    return box.adjusted(-line_width, -line_width, line_width, line_width).intersects(QRectF(viewX, viewY, viewWidth, viewHeight));
+}
+
+void Renderer::recalculateBounds()
+{
+    ViewState& s = state.Edit();
+    double lo[3] = {s.meshLo[0], s.meshLo[1], s.meshLo[2]};
+    double hi[3] = {s.meshHi[0], s.meshHi[1], s.meshHi[2]};
+    if (!s.deformation.IsIdentity())
+    {
+        s.deformation.Bound(lo, hi);
+    }
+    s.bounds.clear();
+    for (int i = 0; i < 8; ++i)
+    {
+        s.bounds.push_back(Point(i & 1 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1], i & 4 ? hi[2] : lo[2]));
+    }
+    s.TransformationMatrix.TransformPoints(s.bounds.data(), s.bounds.size(), s.worldBounds.data());
+}
+
+void Renderer::SetMesh(Mesh const& newMesh)
+{
+    // Reordered once here so every frame submits long chains; selection and
+    // picking work on this mesh, so edge indices stay consistent.
+    SetStripMesh(newMesh.ToStrips());
+}
+
+void Renderer::SetStripMesh(Mesh const& newMesh)
+{
+    ViewState& s = state.Edit();
+    s.mesh = newMesh;
+    std::fill(s.meshLo, s.meshLo + 3, 0);
+    std::fill(s.meshHi, s.meshHi + 3, 0);
+    s.mesh.GetBounds(s.meshLo, s.meshHi);
+    recalculateBounds();
+    state.Publish();
+}
+
+const Mesh& Renderer::GetMesh() const
+{
+    return state.Current().mesh;
+}
+
+void Renderer::TransformFigure(Matrix const& transform)
+{
+    TRACE_SCOPE("transform", "TransformFigure");
+    ViewState& s = state.Edit();
+    s.TransformationMatrix = transform * s.TransformationMatrix;
+    transform.TransformPoints(s.worldBounds.data(), s.worldBounds.size(), s.worldBounds.data());
+    state.Publish();
+}
+
+void Renderer::ProjectFigure(Matrix::ProjectionType type)
+{
+    ViewState& s = state.Edit();
+    s.projection = static_cast<int>(type);
+    if (type == Matrix::ProjectionType::ProjectionPerspective)
+    {
+        s.ProjectionMatrix = Matrix::GetPerspectiveMatrix(s.focalLength);
+    }
+    else if (type == Matrix::ProjectionType::ProjectionCavalier || type == Matrix::ProjectionType::ProjectionCabinet)
+    {
+        s.ProjectionMatrix = Matrix::GetObliqueMatrix(Projection::GetDepthScale(s.projection), s.oblique_angle);
+    }
+    else
+    {
+        s.ProjectionMatrix = Matrix::GetProjectionMatrix(type);
+    }
+    state.Publish();
+}
+
+void Renderer::RevertProjection()
+{
+    ViewState& s = state.Edit();
+    s.ProjectionMatrix = Matrix::GetIdentityMatrix();
+    s.projection = -1;
+    state.Publish();
+}
+
+void Renderer::ResetTransform()
+{
+    ViewState& s = state.Edit();
+    s.TransformationMatrix = Matrix::GetIdentityMatrix();
+    s.worldBounds = s.bounds;
+    s.pan = QPointF();
+    state.Publish();
+}
+
+void Renderer::SetAnimationTransform(Matrix const& transform)
+{
+    ViewState& s = state.Edit();
+    s.AnimationMatrix = transform;
+    state.Publish();
+}
+
+void Renderer::ResetAnimationTransform()
+{
+    ViewState& s = state.Edit();
+    s.AnimationMatrix = Matrix::GetIdentityMatrix();
+    state.Publish();
+}
+
+void Renderer::SetPreviewTransform(Matrix const& transform)
+{
+    ViewState& s = state.Edit();
+    s.PreviewMatrix = transform;
+    state.Publish();
+}
+
+void Renderer::ResetPreviewTransform()
+{
+    ViewState& s = state.Edit();
+    s.PreviewMatrix = Matrix::GetIdentityMatrix();
+    state.Publish();
+}
+
+void Renderer::AddInstance(Matrix const& transform)
+{
+    ViewState& s = state.Edit();
+    auto grown = std::make_shared<std::vector<Matrix>>(*s.instances);
+    grown->push_back(transform);
+    s.instances = std::move(grown);
+    state.Publish();
+}
+
+void Renderer::ClearInstances()
+{
+    ViewState& s = state.Edit();
+    s.instances = std::make_shared<const std::vector<Matrix>>();
+    s.selectedVertex = s.selectedEdge = s.selectedInstance = -1;
+    state.Publish();
+}
+
+size_t Renderer::GetInstanceCount() const
+{
+    return state.Current().instances->size();
+}
+
+Matrix Renderer::GetAccumulatedTransform() const
+{
+    return state.Current().TransformationMatrix;
+}
+
+int Renderer::GetProjection() const
+{
+    return state.Current().projection;
+}
+
+void Renderer::SetProjection(int newProjection)
+{
+    if (newProjection < 0)
+    {
+        RevertProjection();
+        return;
+    }
+    ProjectFigure(static_cast<Matrix::ProjectionType>(newProjection));
+}
+
+void Renderer::SetPerspective(double newFocalLength, double newNearDistance)
+{
+    ViewState& s = state.Edit();
+    s.focalLength = newFocalLength;
+    s.nearDistance = std::min(newNearDistance, newFocalLength);
+    if (s.projection == static_cast<int>(Matrix::ProjectionType::ProjectionPerspective))
+    {
+        s.ProjectionMatrix = Matrix::GetPerspectiveMatrix(s.focalLength);
+    }
+    state.Publish();
+}
+
+double Renderer::GetFocalLength() const
+{
+    return state.Current().focalLength;
+}
+
+double Renderer::GetNearDistance() const
+{
+    return state.Current().nearDistance;
+}
+
+bool Renderer::UnprojectRay(std::vector<Point>& ray, bool& halfLine) const
+{
+    ViewState const& s = state.Current();
+    halfLine = false;
+    if (s.projection < 0 || s.multiView)
+    {
+        return true;
+    }
+    int dropAxis = Projection::GetDroppedAxis(s.projection);
+    int plane = dropAxis >= 0 ? dropAxis : 2;
+    double dk = ray[1].getParameter(plane);
+    if (std::abs(dk) < 1e-9)
+    {
+        return false;
+    }
+    double t = -ray[0].getParameter(plane) / dk;
+    double q[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        q[k] = ray[0].getParameter(k) + t * ray[1].getParameter(k);
+    }
+    q[plane] = 0;
+    Point direction(dropAxis == 0, dropAxis == 1, dropAxis == 2, 0);
+    if (static_cast<Matrix::ProjectionType>(s.projection) == Matrix::ProjectionType::ProjectionPerspective)
+    {
+        // q + t (-q, f) reaches the eye at t = 1 and the near plane at
+        // t = 1 - near / f; only what lies beyond the near plane is drawn.
+        double t0 = 1 - s.nearDistance / s.focalLength;
+        ray = {Point(q[0] * (1 - t0), q[1] * (1 - t0), q[2] + t0 * s.focalLength), Point(q[0], q[1], -s.focalLength, 0)};
+        halfLine = true;
+        return true;
+    }
+    else if (dropAxis < 0)
+    {
+        double depthScale = Projection::GetDepthScale(s.projection);
+        direction = Point(-depthScale * cos(s.oblique_angle), -depthScale * sin(s.oblique_angle), 1, 0);
+    }
+    ray = {Point(q[0], q[1], q[2]), direction};
+    return true;
+}
+
+Matrix Renderer::GetTransformationMatrix() const
+{
+    ViewState const& s = state.Current();
+    return s.ProjectionMatrix * s.PreviewMatrix * s.TransformationMatrix;
+}
+
+void Renderer::SetRotation(double _angleX, double _angleY, double _angleZ)
+{
+    ViewState& s = state.Edit();
+    s.angleX = _angleX;
+    s.angleY = _angleY;
+    s.angleZ = _angleZ;
+    state.Publish();
+}
+
+void Renderer::GetRotation(double& _angleX, double& _angleY, double& _angleZ) const
+{
+    ViewState const& s = state.Current();
+    _angleX = s.angleX;
+    _angleY = s.angleY;
+    _angleZ = s.angleZ;
+}
+
+Matrix Renderer::GetAksonometricMatrix() const
+{
+    ViewState const& s = state.Current();
+    return Matrix::GetAksonometricMatrix(s.angleX, s.angleY, s.angleZ);
+}
+
+void Renderer::SetMultiView(bool newMultiView)
+{
+    ViewState& s = state.Edit();
+    s.multiView = newMultiView;
+    state.Publish();
+}
+
+bool Renderer::IsMultiView() const
+{
+    return state.Current().multiView;
+}
+
+void Renderer::SetPointCloud(bool newPointCloud)
+{
+    ViewState& s = state.Edit();
+    s.pointCloud = newPointCloud;
+    state.Publish();
+}
+
+bool Renderer::IsPointCloud() const
+{
+    return state.Current().pointCloud;
+}
+
+QPointF Renderer::GetCenter() const
+{
+    return QPointF(zx, zy);
+}
+
+void Renderer::SetDeformation(Deformation const& newDeformation)
+{
+    ViewState& s = state.Edit();
+    s.deformation = newDeformation;
+    recalculateBounds();
+    state.Publish();
+}
+
+Deformation const& Renderer::GetDeformation() const
+{
+    return state.Current().deformation;
+}
+
+bool Renderer::GetViewBounds(QRectF& box) const
+{
+    ViewState const& s = state.Current();
+    if (!s.HasGeometry())
+    {
+        return false;
+    }
+    Point corners[8] = {s.worldBounds[0], s.worldBounds[1], s.worldBounds[2], s.worldBounds[3],
+                        s.worldBounds[4], s.worldBounds[5], s.worldBounds[6], s.worldBounds[7]};
+    (s.AnimationMatrix * s.PreviewMatrix).TransformPoints(s.worldBounds.data(), s.worldBounds.size(), corners);
+    const Point units[3] = {Point(1, 0, 0), Point(0, 1, 0), Point(0, 0, 1)};
+    Point directions[3] = {units[0], units[1], units[2]};
+    Matrix::GetAksonometricMatrix(s.angleX, s.angleY, s.angleZ).TransformPoints(units, 3, directions);
+
+    const int dropAxes[4] = {2, 0, 1, -1};
+    double left = INFINITY, right = -INFINITY, top = INFINITY, bottom = -INFINITY;
+    for (int view = 0; view < (s.multiView ? 4 : 1); ++view)
+    {
+        Point projected[8] = {corners[0], corners[1], corners[2], corners[3], corners[4], corners[5], corners[6], corners[7]};
+        char visible[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+        int dropAxis = s.multiView ? dropAxes[view] : -1;
+        if (!s.multiView)
+        {
+            switch (static_cast<Matrix::ProjectionType>(s.projection))
+            {
+            case Matrix::ProjectionType::ProjectionPerspective:
+                Projection::Perspective(projected, 8, visible, s.focalLength, s.nearDistance);
+                break;
+            case Matrix::ProjectionType::ProjectionCavalier:
+            case Matrix::ProjectionType::ProjectionCabinet:
+                Projection::Oblique(projected, 8, Projection::GetDepthScale(s.projection), s.oblique_angle);
+                break;
+            default:
+                dropAxis = Projection::GetDroppedAxis(s.projection);
+            }
+        }
+        for (int i = 0; i < 8; ++i)
+        {
+            if (!visible[i])
+            {
+                continue;
+            }
+            QPointF p;
+            for (int k = 0; k < 3; ++k)
+            {
+                if (k != dropAxis)
+                {
+                    p += directions[k].toQPoint() * projected[i].getParameter(k);
+                }
+            }
+            left = std::min(left, p.x());
+            right = std::max(right, p.x());
+            top = std::min(top, -p.y());
+            bottom = std::max(bottom, -p.y());
+        }
+    }
+    if (left > right)
+    {
+        return false;
+    }
+    box = QRectF(QPointF(left, top), QPointF(right, bottom));
+    return true;
+}
+
+void Renderer::SetPan(QPointF newPan)
+{
+    ViewState& s = state.Edit();
+    s.pan = newPan;
+    state.Publish();
+}
+
+QPointF Renderer::GetPan() const
+{
+    return state.Current().pan;
+}
+
+void Renderer::SetSelection(int vertex, int edge, int instance)
+{
+    ViewState& s = state.Edit();
+    s.selectedVertex = vertex;
+    s.selectedEdge = edge;
+    s.selectedInstance = instance;
+    state.Publish();
+}
+
+int Renderer::GetSelectedVertex() const
+{
+    return state.Current().selectedVertex;
+}
+
+int Renderer::GetSelectedEdge() const
+{
+    return state.Current().selectedEdge;
+}
+
+const std::vector<Matrix>& Renderer::GetInstances() const
+{
+    return *state.Current().instances;
+}
+
+int Renderer::getUnit() const
+{
+    return state.Current().u;
+}
+
+void Renderer::SetUnit(int nu)
+{
+    ViewState& s = state.Edit();
+    s.u = nu;
+    state.Publish();
+}
+
+void Renderer::SetQuality(Quality newQuality)
+{
+    if (state.Current().quality == newQuality)
+    {
+        return;
+    }
+    ViewState& s = state.Edit();
+    s.quality = newQuality;
+    state.Publish();
+}
+
+Renderer::Quality Renderer::GetQuality() const
+{
+    return state.Current().quality;
+}
+
+void Renderer::SetPreviewEdgeBudget(size_t budget)
+{
+    preview_edge_budget = budget;
+}
+
+Renderer::QualityStats Renderer::GetQualityStats(Quality quality) const
+{
+    return qualityStats[static_cast<int>(quality)];
+}
+
+AllocationCounter::Counts const& Renderer::GetFrameAllocations() const
+{
+    return frameAllocations;
+}
+
+// Geometry the renderer keeps resident between frames: the mesh buffers,
+// instance transforms, the deformed vertices, the per-instance scratch, the
+// frame arena and the figure buffers.
+size_t Renderer::GetGeometryBytes() const
+{
+    ViewState const& s = frame();
+    size_t bytes = s.mesh.GetStoredVertexCount() * Mesh::GetVertexSize(s.mesh.GetVertexFormat())
+                 + s.mesh.GetEdgeCount() * sizeof(Edge)
+                 + deformedVertices.capacity() * sizeof(PackedVertex)
+                 + screenVertices.capacity() * sizeof(QPointF)
+                 + (worldVertices.capacity() + projectedVertices.capacity()) * sizeof(Point)
+                 + visibleVertices.capacity()
+                 + s.instances->size() * sizeof(Matrix)
+                 + arena.GetCapacity()
+                 + splatter.GetBytes();
+    for (Polylines const& lines : figureLines)
+    {
+        bytes += lines.points.capacity() * sizeof(QPointF) + lines.counts.capacity() * sizeof(int)
+               + lines.segments.capacity() * sizeof(QLineF);
+    }
+    return bytes;
+}
+
+size_t Renderer::GetPeakGeometryBytes() const
+{
+    return peakGeometryBytes;
+}
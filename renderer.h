@@ -0,0 +1,288 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QPainter>
+#include <QPainterPath>
+#include <QLineF>
+#include <QStaticText>
+#include <QHash>
+#include <QPair>
+#include <cmath>
+#include <QtMath>
+#include <vector>
+#include "matrix.h"
+#include "mesh.h"
+#include "deformation.h"
+#include "pointsplatter.h"
+#include "framearena.h"
+#include "triplebuffer.h"
+#include "allocationcounter.h"
+
+class Renderer
+{
+public:
+    // Preview is used while the user drags or an animation runs: no
+    // antialiasing and, above the edge budget, only every n-th edge is drawn.
+    enum class Quality
+    {
+        Preview,
+        Refined
+    };
+    struct QualityStats
+    {
+        int frames = 0;
+        double lastMs = 0;
+        double totalMs = 0;
+    };
+    Renderer();
+    // PrepareFrame followed by Draw, recorded in the quality stats.
+    void Render(QPainter& pt, QSize size);
+    void PrepareFrame(QSize size);
+    // Paints the frame the last PrepareFrame built, for the same size.
+    void Draw(QPainter& pt, QSize size);
+    void SetMesh(Mesh const& newMesh);
+    // Takes newMesh as it is, for meshes whose edges are already in strip
+    // order, such as every frame of a stream.
+    void SetStripMesh(Mesh const& newMesh);
+    const Mesh& GetMesh() const;
+    void SetDeformation(Deformation const& newDeformation);
+    Deformation const& GetDeformation() const;
+    void TransformFigure(Matrix const& transform);
+    void ProjectFigure(Matrix::ProjectionType type);
+    void RevertProjection();
+    int GetProjection() const;
+    void SetProjection(int newProjection);
+    void SetPerspective(double newFocalLength, double newNearDistance);
+    double GetFocalLength() const;
+    double GetNearDistance() const;
+    // Turns a view-space pick line into the line through the scene. In
+    // perspective the result is a half-line starting on the near plane and
+    // pointing away from the eye, and halfLine is set.
+    bool UnprojectRay(std::vector<Point>& ray, bool& halfLine) const;
+    void ResetTransform();
+    void SetAnimationTransform(Matrix const& transform);
+    void ResetAnimationTransform();
+    void SetPreviewTransform(Matrix const& transform);
+    void ResetPreviewTransform();
+    void AddInstance(Matrix const& transform);
+    void ClearInstances();
+    size_t GetInstanceCount() const;
+    const std::vector<Matrix>& GetInstances() const;
+    void SetRotation(double _angleX, double _angleY, double _angleZ);
+    void GetRotation(double& _angleX, double& _angleY, double& _angleZ) const;
+    Matrix GetTransformationMatrix() const;
+    Matrix GetAccumulatedTransform() const;
+    Matrix GetModelMatrix() const;
+    Matrix GetAksonometricMatrix() const;
+    void SetMultiView(bool newMultiView);
+    bool IsMultiView() const;
+    // Draws the mesh's vertices as depth-shaded pixels instead of its
+    // edges; meshes without edges are point clouds.
+    void SetPointCloud(bool newPointCloud);
+    bool IsPointCloud() const;
+    QPointF GetCenter() const;
+    // The model's box on screen at one pixel per unit, relative to the
+    // origin and covering every view in multi-view mode. Eight corners
+    // whatever the mesh size; false if nothing of it is in front of the
+    // camera.
+    bool GetViewBounds(QRectF& box) const;
+    // Shift of the origin from the centre of each view, in units.
+    void SetPan(QPointF newPan);
+    QPointF GetPan() const;
+    QPointF Adjust(const Point& p);
+    void SetSelection(int vertex, int edge, int instance);
+    int GetSelectedVertex() const;
+    int GetSelectedEdge() const;
+    void SetUnit(int nu);
+    int getUnit() const;
+    void SetQuality(Quality newQuality);
+    Quality GetQuality() const;
+    void SetPreviewEdgeBudget(size_t budget);
+    QualityStats GetQualityStats(Quality quality) const;
+    AllocationCounter::Counts const& GetFrameAllocations() const;
+    size_t GetGeometryBytes() const;
+    size_t GetPeakGeometryBytes() const;
+private:
+    // Everything input handlers change. Writers edit and publish a new version
+    // through the triple buffer; a frame renders from one consistent version.
+    // Publishing copies the whole state, so the large parts that change
+    // rarely are shared: the mesh refers to its buffers, and instances is
+    // replaced rather than edited in place.
+    struct ViewState
+    {
+        double angleX = 19.47 / 180 * 3.14;
+        double angleY = -20.7 / 180 * 3.14;
+        double angleZ = 0;
+        Matrix TransformationMatrix = Matrix::GetIdentityMatrix();
+        Matrix ProjectionMatrix = Matrix::GetIdentityMatrix();
+        Matrix AnimationMatrix = Matrix::GetIdentityMatrix();
+        Matrix PreviewMatrix = Matrix::GetIdentityMatrix();
+        // Box of the undeformed mesh, found once per mesh; bounds widens it
+        // by the deformation.
+        double meshLo[3] = {0, 0, 0};
+        double meshHi[3] = {0, 0, 0};
+        std::vector<Point> bounds = std::vector<Point>(8, Point(0, 0, 0));
+        // The corners of bounds under TransformationMatrix, carried along
+        // with every transform instead of rescanning the vertices.
+        std::vector<Point> worldBounds = std::vector<Point>(8, Point(0, 0, 0));
+        std::shared_ptr<const std::vector<Matrix>> instances = std::make_shared<const std::vector<Matrix>>();
+        Mesh mesh;
+        Deformation deformation;
+        int projection = -1;
+        double focalLength = 15;
+        double nearDistance = 0.5;
+        double oblique_angle = M_PI / 4;
+        int selectedVertex = -1;
+        int selectedEdge = -1;
+        int selectedInstance = -1;
+        bool multiView = false;
+        bool pointCloud = false;
+        int u = 24;
+        QPointF pan;
+        Quality quality = Quality::Refined;
+        Matrix GetModelMatrix() const;
+        // Edges to draw, or in point-cloud mode vertices.
+        bool HasGeometry() const;
+    };
+    // Screen-space geometry for one view, submitted with one drawLines call
+    // for isolated edges and one drawPolyline per longer chain. The vectors
+    // keep their capacity across frames.
+    struct Polylines
+    {
+        std::vector<QPointF> points;
+        std::vector<int> counts;
+        std::vector<QLineF> segments;
+        void Clear()
+        {
+            points.clear();
+            counts.clear();
+            segments.clear();
+        }
+        void MoveTo(QPointF p)
+        {
+            Finish();
+            points.push_back(p);
+            counts.push_back(1);
+        }
+        void LineTo(QPointF p)
+        {
+            points.push_back(p);
+            ++counts.back();
+        }
+        // Moves a two-point chain over to the segment list.
+        void Finish()
+        {
+            if (!counts.empty() && counts.back() == 2)
+            {
+                segments.emplace_back(points[points.size() - 2], points.back());
+                points.resize(points.size() - 2);
+                counts.pop_back();
+            }
+        }
+    };
+    struct TickLabel
+    {
+        QPointF position;
+        int value;
+    };
+    struct AxisCache
+    {
+        double angleX = NAN;
+        double angleY = NAN;
+        double angleZ = NAN;
+        int unit = 0;
+        QLineF axes[3];
+        QLineF units[3];
+        std::vector<QLineF> ticks;
+        std::vector<TickLabel> tickLabels;
+        QPainterPath arrows[3];
+        QPointF labels[3];
+    };
+    TripleBuffer<ViewState> state;
+    std::vector<Point> axis;
+    Matrix AksonometricMatrix;
+    AxisCache axisCache;
+    FrameArena arena;
+    Polylines figureLines[4];
+    // The mesh this frame draws: the view state's mesh, or a view of its
+    // edges over deformedVertices.
+    Mesh frameMesh;
+    std::vector<PackedVertex> deformedVertices;
+    // Per-instance scratch: screen positions, the world points shared by
+    // perspective and the four views, and for perspective the projected
+    // points with their near-plane flags.
+    std::vector<QPointF> screenVertices;
+    std::vector<Point> worldVertices;
+    std::vector<Point> projectedVertices;
+    std::vector<char> visibleVertices;
+    PointSplatter splatter;
+    bool selectionVisible = false;
+    QPointF selectionEnds[2];
+    int selectionVertexEnd = -1;
+    size_t edgeStride = 1;
+    size_t preview_edge_budget = 200000;
+    size_t preview_point_budget = 4000000;
+    QualityStats qualityStats[2];
+    AllocationCounter::Counts frameAllocations;
+    size_t peakGeometryBytes = 0;
+    QPen figurePen, selectionPen, boxPen, unitPen;
+    QPen axisPens[3];
+    QBrush axisBrush, selectionBrush;
+    QFont labelFont;
+    QString labelFontKey;
+    int labelHeight = 0;
+    // Laid-out label text keyed by (font key, string), so text is shaped
+    // once and reused by every frame and zoom level.
+    QHash<QPair<QString, QString>, QStaticText> labelCache;
+    std::vector<QString> tickTexts;
+    double tick_length = 1.0;
+    int axis_width = 2;
+    int box_offset = 1;
+    int box_width = 1;
+    int pixel_width = 1;
+    int line_width = 3;
+    int axis_length = 20;
+    int viewX = 0;
+    int viewY = 0;
+    int viewWidth = 0;
+    int viewHeight = 0;
+    int zx = 0;
+    int zy = 0;
+    QColor XColor = Qt::blue;
+    QColor YColor = Qt::green;
+    QColor ZColor = Qt::magenta;
+    QColor gridColor = Qt::gray;
+    QColor axisColor = Qt::black;
+    QColor boxColor = Qt::gray;
+    ViewState const& frame() const;
+    void recalculateAxis();
+    void recalculateAxisCache();
+    void recalculateStyle();
+    QStaticText const& label(QString const& text);
+    void drawLabel(QPainter& p, QPointF center, QString const& text);
+    void setViewport(QRect viewport);
+    QPointF adjust(const Point& p, int dropAxis = -1) const;
+    void recalculateBounds();
+    bool isInstanceVisible(Matrix const& transform);
+    void inline drawBox(QPainter(&p));
+    void inline drawGrid(QPainter& p);
+    void inline drawAxis(QPainter& p);
+    void inline drawTicks(QPainter& p);
+    void inline drawArrows(QPainter& p);
+    void inline drawFigure(QPainter& p, int view);
+    void prepareFigure();
+    void appendInstance(Polylines& lines, Matrix const& transform);
+    void appendPerspective(Polylines& lines, const Point* world);
+    Matrix screenMatrix(Matrix const& model, int dropAxis) const;
+    void appendScreen(Polylines& lines, Matrix const& screen);
+    void appendWorld(Polylines& lines, Matrix const& select, int dropAxis);
+    void appendEdges(Polylines& lines, const QPointF* points);
+    void splatInstance(Matrix const& transform);
+    PointSplatter::View parallelView(Matrix const& screen, Matrix const& model, int depthAxis) const;
+    PointSplatter::View perspectiveView(Matrix const& model) const;
+    bool projectPoint(Point const& world, QPointF& screen);
+    void prepareSelection();
+    void inline drawSelection(QPainter& p);
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,192 @@
+#include "scenefile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+static_assert(sizeof(PackedVertex) == 3 * sizeof(float) && std::is_trivially_copyable<PackedVertex>::value,
+              "PackedVertex is stored in scene files as three raw floats");
+static_assert(sizeof(QuantizedVertex) == 3 * sizeof(quint16) && std::is_trivially_copyable<QuantizedVertex>::value,
+              "QuantizedVertex is stored in scene files as three raw 16-bit values");
+static_assert(sizeof(Edge) == 2 * sizeof(qint32) && std::is_trivially_copyable<Edge>::value,
+              "Edge is stored in scene files as two raw 32-bit indices");
+
+namespace
+{
+quint64 alignUp(quint64 offset, quint64 alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool writeAll(QSaveFile& file, const void* data, quint64 size)
+{
+    return size == 0 || file.write(static_cast<const char*>(data), static_cast<qint64>(size)) == static_cast<qint64>(size);
+}
+
+bool allFinite(const double* values, int count)
+{
+    return std::all_of(values, values + count, [](double value) { return std::isfinite(value); });
+}
+
+bool fail(QString* error, QString const& message)
+{
+    if (error)
+    {
+        *error = message;
+    }
+    return false;
+}
+}
+
+bool SceneFile::Save(QString const& path, Mesh const& mesh, View const& view, QString* error)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.headerSize = sizeof(Header);
+    header.vertexCount = mesh.GetStoredVertexCount();
+    header.vertexOffset = alignUp(sizeof(Header), alignment);
+    header.edgeCount = mesh.GetEdgeCount();
+    header.vertexFormat = static_cast<quint32>(mesh.GetVertexFormat());
+    for (int k = 0; k < 3; ++k)
+    {
+        header.quantizationScale[k] = mesh.GetQuantization().scale[k];
+        header.quantizationOffset[k] = mesh.GetQuantization().offset[k];
+        header.extrusion[k] = mesh.GetExtrusion().getParameter(k);
+    }
+    header.extruded = mesh.IsExtrusion();
+    header.stripOrdered = view.stripOrdered;
+    quint64 vertexBytes = header.vertexCount * Mesh::GetVertexSize(mesh.GetVertexFormat());
+    header.edgeOffset = alignUp(header.vertexOffset + vertexBytes, alignment);
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            header.transform[i * 4 + j] = view.transform.getElement(i, j);
+        }
+    }
+    header.angles[0] = view.angleX;
+    header.angles[1] = view.angleY;
+    header.angles[2] = view.angleZ;
+    header.projection = view.projection;
+    header.unit = view.unit;
+    header.focalLength = view.focalLength;
+    header.nearDistance = view.nearDistance;
+
+    // QSaveFile writes next to path and only replaces it on commit(), so a
+    // failed save leaves the previous scene intact and no temporary behind.
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return fail(error, file.errorString());
+    }
+    QByteArray padding(static_cast<int>(alignment), '\0');
+    quint64 edgeBytes = header.edgeCount * sizeof(Edge);
+    if (!writeAll(file, &header, sizeof(header))
+        || !writeAll(file, padding.constData(), header.vertexOffset - sizeof(header))
+        || !writeAll(file, mesh.GetVertexData(), vertexBytes)
+        || !writeAll(file, padding.constData(), header.edgeOffset - header.vertexOffset - vertexBytes)
+        || !writeAll(file, mesh.GetEdges(), edgeBytes))
+    {
+        QString message = file.errorString();
+        file.cancelWriting();
+        return fail(error, message);
+    }
+    if (!file.commit())
+    {
+        return fail(error, file.errorString());
+    }
+    return true;
+}
+
+bool SceneFile::Load(QString const& path, Mesh& mesh, View& view, QString* error)
+{
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QFile::ReadOnly))
+    {
+        return fail(error, file->errorString());
+    }
+    quint64 size = file->size();
+    if (size < sizeof(Header))
+    {
+        return fail(error, "Файл сцены повреждён");
+    }
+    const uchar* data = file->map(0, size);
+    if (!data)
+    {
+        return fail(error, file->errorString());
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->headerSize != sizeof(Header))
+    {
+        return fail(error, "Неизвестный формат файла сцены");
+    }
+    if (header->version != version)
+    {
+        return fail(error, QString("Неподдерживаемая версия файла сцены: %1").arg(header->version));
+    }
+    if (header->vertexFormat > static_cast<quint32>(Mesh::VertexFormat::Quantized16))
+    {
+        return fail(error, "Файл сцены повреждён");
+    }
+    Mesh::VertexFormat format = static_cast<Mesh::VertexFormat>(header->vertexFormat);
+    // Counts are compared against what fits in the file before anything is
+    // multiplied, so a hostile header cannot wrap the size check around.
+    if (header->vertexOffset % alignof(PackedVertex) != 0 || header->edgeOffset % alignof(Edge) != 0
+        || header->vertexOffset > size || header->vertexCount > (size - header->vertexOffset) / Mesh::GetVertexSize(format)
+        || header->edgeOffset > size || header->edgeCount > (size - header->edgeOffset) / sizeof(Edge))
+    {
+        return fail(error, "Файл сцены повреждён");
+    }
+    // Edges index the back copy of an extrusion too; Edge holds 32-bit
+    // indices, so no mesh with edges can have more vertices than that.
+    quint64 vertexCount = header->extruded ? 2 * header->vertexCount : header->vertexCount;
+    const Edge* edges = reinterpret_cast<const Edge*>(data + header->edgeOffset);
+    if ((header->edgeCount > 0 && vertexCount > quint64(std::numeric_limits<qint32>::max()))
+        || !std::all_of(edges, edges + header->edgeCount, [vertexCount](Edge const& e)
+           {
+               return e.a >= 0 && e.b >= 0 && quint64(e.a) < vertexCount && quint64(e.b) < vertexCount;
+           }))
+    {
+        return fail(error, "Файл сцены повреждён");
+    }
+    // The view goes straight into the renderer: a zero or NaN focal length
+    // would turn every projected vertex into NaN, and the projection is cast
+    // to Matrix::ProjectionType.
+    if (!allFinite(header->transform, 16) || !allFinite(header->angles, 3) || !allFinite(header->quantizationScale, 3)
+        || !allFinite(header->quantizationOffset, 3) || !allFinite(header->extrusion, 3)
+        || !std::isfinite(header->focalLength) || !std::isfinite(header->nearDistance)
+        || header->projection < -1 || header->projection > static_cast<qint32>(Matrix::ProjectionType::ProjectionCabinet)
+        || header->focalLength <= 0 || header->nearDistance <= 0 || header->nearDistance > header->focalLength
+        || header->unit < 0)
+    {
+        return fail(error, "Файл сцены повреждён");
+    }
+
+    Mesh::Quantization quantization;
+    for (int k = 0; k < 3; ++k)
+    {
+        quantization.scale[k] = header->quantizationScale[k];
+        quantization.offset[k] = header->quantizationOffset[k];
+    }
+    mesh = Mesh::FromBuffers(data + header->vertexOffset, format, quantization, header->vertexCount,
+                             edges, header->edgeCount, file);
+    if (header->extruded)
+    {
+        mesh = mesh.WithExtrusion(Point(header->extrusion[0], header->extrusion[1], header->extrusion[2], 0));
+    }
+    view.transform = Matrix::FromValues(4, 4, header->transform);
+    view.angleX = header->angles[0];
+    view.angleY = header->angles[1];
+    view.angleZ = header->angles[2];
+    view.projection = header->projection;
+    view.unit = header->unit;
+    view.focalLength = header->focalLength;
+    view.nearDistance = header->nearDistance;
+    view.stripOrdered = header->stripOrdered != 0;
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <QString>
+#include "matrix.h"
+#include "mesh.h"
+
+class SceneFile
+{
+public:
+    struct View
+    {
+        Matrix transform = Matrix::GetIdentityMatrix();
+        int projection = -1;
+        double focalLength = 15;
+        double nearDistance = 0.5;
+        double angleX = 0;
+        double angleY = 0;
+        double angleZ = 0;
+        int unit = 0;
+        // The edges are already in Mesh::ToStrips order, as everything the
+        // renderer holds is, so a loaded mesh can go to SetStripMesh as is.
+        bool stripOrdered = false;
+    };
+    static bool Save(QString const& path, Mesh const& mesh, View const& view, QString* error = nullptr);
+    static bool Load(QString const& path, Mesh& mesh, View& view, QString* error = nullptr);
+private:
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 headerSize;
+        quint64 vertexOffset;
+        // Stored vertices; for an extrusion only the profile.
+        quint64 vertexCount;
+        quint64 edgeOffset;
+        quint64 edgeCount;
+        double transform[16];
+        double angles[3];
+        qint32 projection;
+        qint32 unit;
+        double focalLength;
+        double nearDistance;
+        quint32 vertexFormat;
+        quint32 extruded;
+        quint32 stripOrdered;
+        double quantizationScale[3];
+        double quantizationOffset[3];
+        double extrusion[3];
+    };
+    static constexpr char magic[8] = {'L', 'A', 'B', '6', 'S', 'C', 'N', '\0'};
+    static constexpr quint32 version = 5;
+    static constexpr quint64 alignment = 64;
+};
+
+#endif // SCENEFILE_H
@@ -0,0 +1,367 @@
+#include "stream.h"
+#include "trace.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <thread>
+
+static_assert(std::atomic<quint32>::is_always_lock_free,
+              "the slot exchange word is shared between processes and must not hide a lock");
+
+namespace
+{
+const char magic[8] = {'L', 'A', 'B', '6', 'S', 'T', 'R', 'M'};
+const quint32 version = 1;
+const quint32 slotCount = 3;
+const quint32 slotIndex = 3;
+const quint32 freshSlot = 4;
+const quint64 alignment = 64;
+
+struct Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 slotCount;
+    quint64 vertexCount;
+    quint64 edgeCount;
+    quint64 edgeOffset;
+    quint64 slotOffset;
+    quint64 slotStride;
+    // The consumer's slot, kept here so a consumer that attaches later
+    // resumes with the slot the previous one held.
+    quint32 front;
+    alignas(64) std::atomic<quint32> middle;
+};
+
+// Each slot starts with this, the vertices follow at the next alignment.
+struct Slot
+{
+    quint64 sequence;
+    qint64 timestamp;
+};
+
+quint64 alignUp(quint64 offset, quint64 alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool fail(QString* error, QString const& message)
+{
+    if (error)
+    {
+        *error = message;
+    }
+    return false;
+}
+
+// Offset and stride come from the side's own copy, never from the header,
+// which the other process can rewrite at any time.
+Slot* slotAt(void* segment, quint64 slotOffset, quint64 slotStride, quint32 index)
+{
+    return reinterpret_cast<Slot*>(static_cast<char*>(segment) + slotOffset + index * slotStride);
+}
+
+PackedVertex* slotVertices(Slot* slot)
+{
+    return reinterpret_cast<PackedVertex*>(reinterpret_cast<char*>(slot) + alignUp(sizeof(Slot), alignment));
+}
+
+// The header fields a consumer relies on. The producer is another process
+// and can rewrite the header at any time, so they are copied out once and
+// then checked and used as those same values.
+struct Layout
+{
+    quint64 vertexCount = 0;
+    quint64 edgeCount = 0;
+    quint64 edgeOffset = 0;
+    quint64 slotOffset = 0;
+    quint64 slotStride = 0;
+    quint32 front = 0;
+};
+
+// Every offset and index is checked before anything is read through it.
+bool readLayout(Header const* header, quint64 size, Layout& layout)
+{
+    if (size < sizeof(Header) || !std::equal(magic, magic + sizeof(magic), header->magic)
+        || header->version != version || header->slotCount != slotCount)
+    {
+        return false;
+    }
+    layout.vertexCount = header->vertexCount;
+    layout.edgeCount = header->edgeCount;
+    layout.edgeOffset = header->edgeOffset;
+    layout.slotOffset = header->slotOffset;
+    layout.slotStride = header->slotStride;
+    layout.front = header->front;
+    return layout.front < slotCount
+        && layout.vertexCount <= size / sizeof(PackedVertex) && layout.edgeCount <= size / sizeof(Edge)
+        && layout.edgeOffset % alignof(Edge) == 0 && layout.edgeOffset <= size - layout.edgeCount * sizeof(Edge)
+        && layout.slotStride % alignment == 0 && layout.slotOffset % alignment == 0
+        && layout.slotStride >= alignUp(sizeof(Slot), alignment) + layout.vertexCount * sizeof(PackedVertex)
+        && layout.slotStride <= size / slotCount && layout.slotOffset <= size - slotCount * layout.slotStride;
+}
+}
+
+struct Stream::Consumer::Attachment
+{
+    QSharedMemory memory;
+    Header* header = nullptr;
+    // Copied from the header once it has been validated.
+    quint64 slotOffset = 0;
+    quint64 slotStride = 0;
+    Mesh strips;
+    Slot* SlotAt(quint32 index) const
+    {
+        return slotAt(header, slotOffset, slotStride, index);
+    }
+};
+
+qint64 Stream::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Stream::Producer::Create(QString const& key, size_t vertexCount, std::vector<Edge> const& edges, QString* error)
+{
+    quint64 edgeOffset = alignUp(sizeof(Header), alignment);
+    quint64 slotOffset = alignUp(edgeOffset + edges.size() * sizeof(Edge), alignment);
+    quint64 slotStride = alignUp(alignUp(sizeof(Slot), alignment) + vertexCount * sizeof(PackedVertex), alignment);
+    memory.setKey(key);
+    if (!memory.create(slotOffset + slotCount * slotStride) && memory.error() == QSharedMemory::AlreadyExists)
+    {
+        // Left behind by a producer that crashed: on Unix the last detach
+        // removes it. A live producer keeps it attached and the retry fails.
+        if (memory.attach())
+        {
+            memory.detach();
+        }
+        memory.create(slotOffset + slotCount * slotStride);
+    }
+    if (!memory.isAttached())
+    {
+        return fail(error, memory.errorString());
+    }
+    memory.lock();
+    std::memset(memory.data(), 0, memory.size());
+    Header* header = new (memory.data()) Header();
+    header->version = version;
+    header->slotCount = slotCount;
+    header->vertexCount = vertexCount;
+    header->edgeCount = edges.size();
+    header->edgeOffset = edgeOffset;
+    header->slotOffset = slotOffset;
+    header->slotStride = slotStride;
+    header->front = 0;
+    header->middle.store(1, std::memory_order_relaxed);
+    std::copy(edges.begin(), edges.end(), reinterpret_cast<Edge*>(reinterpret_cast<char*>(header) + edgeOffset));
+    // Written last: a consumer checks it before trusting the rest.
+    std::memcpy(header->magic, magic, sizeof(magic));
+    memory.unlock();
+    this->slotOffset = slotOffset;
+    this->slotStride = slotStride;
+    back = 2;
+    sequence = 0;
+    return true;
+}
+
+PackedVertex* Stream::Producer::Vertices()
+{
+    return slotVertices(slotAt(memory.data(), slotOffset, slotStride, back));
+}
+
+void Stream::Producer::Publish()
+{
+    Header* header = static_cast<Header*>(memory.data());
+    Slot* slot = slotAt(header, slotOffset, slotStride, back);
+    slot->sequence = ++sequence;
+    slot->timestamp = Now();
+    back = header->middle.exchange(back | freshSlot, std::memory_order_acq_rel) & slotIndex;
+}
+
+quint64 Stream::Producer::GetSequence() const
+{
+    return sequence;
+}
+
+bool Stream::Consumer::Attach(QString const& key, QString* error)
+{
+    Detach();
+    auto data = std::make_shared<Attachment>();
+    data->memory.setKey(key);
+    if (!data->memory.attach(QSharedMemory::ReadWrite))
+    {
+        return fail(error, data->memory.errorString());
+    }
+    data->memory.lock();
+    data->header = static_cast<Header*>(data->memory.data());
+    Layout layout;
+    bool valid = readLayout(data->header, static_cast<quint64>(data->memory.size()), layout);
+    // The edges are checked and ordered on a copy for the same reason.
+    auto edges = std::make_shared<std::vector<Edge>>();
+    if (valid)
+    {
+        const Edge* shared = reinterpret_cast<const Edge*>(reinterpret_cast<const char*>(data->header) + layout.edgeOffset);
+        edges->assign(shared, shared + layout.edgeCount);
+    }
+    data->memory.unlock();
+    qint64 vertexCount = static_cast<qint64>(layout.vertexCount);
+    if (!valid || !std::all_of(edges->begin(), edges->end(), [vertexCount](Edge const& e)
+        {
+            return e.a >= 0 && e.b >= 0 && e.a < vertexCount && e.b < vertexCount;
+        }))
+    {
+        return fail(error, QString("Разделяемая память «%1» не содержит потока Lab6 или повреждена").arg(key));
+    }
+    data->slotOffset = layout.slotOffset;
+    data->slotStride = layout.slotStride;
+    front = layout.front;
+    data->strips = Mesh::FromBuffers(slotVertices(data->SlotAt(front)), Mesh::VertexFormat::Float, Mesh::Quantization(),
+                                     layout.vertexCount, edges->data(), edges->size(), edges).ToStrips();
+    attachment = std::move(data);
+    Acquire();
+    if (!attachment)
+    {
+        return fail(error, QString("Разделяемая память «%1» не содержит потока Lab6 или повреждена").arg(key));
+    }
+    return true;
+}
+
+void Stream::Consumer::Detach()
+{
+    attachment.reset();
+    front = 0;
+}
+
+bool Stream::Consumer::IsAttached() const
+{
+    return attachment != nullptr;
+}
+
+bool Stream::Consumer::Acquire()
+{
+    if (!attachment)
+    {
+        return false;
+    }
+    Header* header = attachment->header;
+    if (!(header->middle.load(std::memory_order_acquire) & freshSlot))
+    {
+        return false;
+    }
+    quint32 taken = header->middle.exchange(front, std::memory_order_acq_rel) & slotIndex;
+    if (taken >= slotCount)
+    {
+        // No producer ever publishes this index; the segment is corrupt.
+        Detach();
+        return false;
+    }
+    front = taken;
+    header->front = front;
+    return true;
+}
+
+Mesh Stream::Consumer::GetMesh() const
+{
+    if (!attachment)
+    {
+        return Mesh();
+    }
+    Mesh const& strips = attachment->strips;
+    return Mesh::FromBuffers(slotVertices(attachment->SlotAt(front)), Mesh::VertexFormat::Float, Mesh::Quantization(),
+                             strips.GetVertexCount(), strips.GetEdges(), strips.GetEdgeCount(), attachment);
+}
+
+quint64 Stream::Consumer::GetSequence() const
+{
+    return attachment ? attachment->SlotAt(front)->sequence : 0;
+}
+
+qint64 Stream::Consumer::GetTimestamp() const
+{
+    return attachment ? attachment->SlotAt(front)->timestamp : 0;
+}
+
+int Stream::Run(QStringList const& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Эталонный источник потока вершин через разделяемую память");
+    parser.addHelpOption();
+    QCommandLineOption produceOption("produce", "Ключ разделяемой памяти.", "key", DefaultKey);
+    QCommandLineOption ringsOption("rings", "Колец тора.", "count", "200");
+    QCommandLineOption segmentsOption("segments", "Сегментов в кольце.", "count", "100");
+    QCommandLineOption rateOption("rate", "Кадров в секунду.", "fps", "120");
+    QCommandLineOption secondsOption("seconds", "Длительность, 0 — до остановки.", "seconds", "0");
+    parser.addOption(produceOption);
+    parser.addOption(ringsOption);
+    parser.addOption(segmentsOption);
+    parser.addOption(rateOption);
+    parser.addOption(secondsOption);
+    parser.process(arguments);
+
+    int rings = parser.value(ringsOption).toInt();
+    int segments = parser.value(segmentsOption).toInt();
+    double rate = parser.value(rateOption).toDouble();
+    double seconds = parser.value(secondsOption).toDouble();
+    if (rings < 3 || segments < 3 || rate <= 0)
+    {
+        qWarning().noquote() << "Использование: Lab6 --produce <ключ> [--rings N] [--segments N] [--rate кадр/с] [--seconds N]";
+        return 1;
+    }
+
+    Mesh torus = Mesh::Torus(rings, segments);
+    std::vector<PackedVertex> rest(torus.GetVertexCount());
+    std::vector<float> phase(rest.size());
+    for (size_t i = 0; i < rest.size(); ++i)
+    {
+        Point p = torus.GetVertex(i);
+        rest[i] = {float(p.getParameter(0)), float(p.getParameter(1)), float(p.getParameter(2))};
+        phase[i] = 3 * std::atan2(rest[i].z, rest[i].x);
+    }
+    Producer producer;
+    QString error;
+    QString key = parser.value(produceOption);
+    if (!producer.Create(key, rest.size(), std::vector<Edge>(torus.GetEdges(), torus.GetEdges() + torus.GetEdgeCount()), &error))
+    {
+        qWarning().noquote() << key << ":" << error;
+        return 1;
+    }
+    qInfo().noquote() << QString("Поток «%1»: %2 вершин, %3 рёбер, %4 кадр/с")
+                         .arg(key).arg(rest.size()).arg(torus.GetEdgeCount()).arg(rate);
+
+    auto period = std::chrono::nanoseconds(static_cast<qint64>(1e9 / rate));
+    auto next = std::chrono::steady_clock::now();
+    QElapsedTimer wall;
+    wall.start();
+    qint64 reportedAt = 0;
+    quint64 reportedFrames = 0;
+    while (seconds <= 0 || wall.elapsed() < seconds * 1000)
+    {
+        {
+            TRACE_SCOPE("stream", "produce frame");
+            float t = static_cast<float>(wall.nsecsElapsed() / 1e9);
+            PackedVertex* out = producer.Vertices();
+            for (size_t i = 0; i < rest.size(); ++i)
+            {
+                out[i] = {rest[i].x, rest[i].y + 0.6f * std::sin(phase[i] - float(2 * M_PI) * t), rest[i].z};
+            }
+            producer.Publish();
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+        if (wall.elapsed() - reportedAt >= 1000)
+        {
+            qInfo().noquote() << QString("%1 кадров, %2 кадр/с")
+                                 .arg(producer.GetSequence())
+                                 .arg((producer.GetSequence() - reportedFrames) * 1000.0 / (wall.elapsed() - reportedAt), 0, 'f', 1);
+            reportedAt = wall.elapsed();
+            reportedFrames = producer.GetSequence();
+        }
+    }
+    return 0;
+}
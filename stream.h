@@ -0,0 +1,72 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <QSharedMemory>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+#include "mesh.h"
+
+// Live geometry from another local process through shared memory. The
+// producer (a simulation) creates the segment: a header, the edge list,
+// written once, and three vertex slots. The slots are exchanged the way
+// TripleBuffer's are, with the exchange word inside the segment: the
+// producer fills its own slot and swaps it in as the newest frame, the
+// consumer swaps the newest frame out for the slot it held. Neither side
+// ever waits for the other, and the consumer reads a complete frame in
+// place, without copying, until its next Acquire.
+class Stream
+{
+public:
+    static constexpr const char* DefaultKey = "lab6-stream";
+    // Monotonic nanoseconds, comparable between processes on one machine.
+    static qint64 Now();
+
+    class Producer
+    {
+    public:
+        bool Create(QString const& key, size_t vertexCount, std::vector<Edge> const& edges, QString* error);
+        // The slot for the next frame: vertexCount vertices.
+        PackedVertex* Vertices();
+        // Makes the filled slot the newest frame, stamped with Now().
+        void Publish();
+        quint64 GetSequence() const;
+    private:
+        QSharedMemory memory;
+        quint64 slotOffset = 0;
+        quint64 slotStride = 0;
+        quint32 back = 2;
+        quint64 sequence = 0;
+    };
+
+    // Only one consumer may be attached at a time.
+    class Consumer
+    {
+    public:
+        bool Attach(QString const& key, QString* error);
+        void Detach();
+        bool IsAttached() const;
+        // Takes the newest published frame, if there is a newer one than the
+        // held frame. The held slot goes back to the producer, so a mesh from
+        // an earlier GetMesh() must not be drawn after this returns true.
+        // Detaches when the segment turns out to be corrupt.
+        bool Acquire();
+        // The held frame over its slot in shared memory, with the edges put
+        // in strip order once on attach, so it goes to the renderer as is.
+        Mesh GetMesh() const;
+        // Producer's count and Now() at publication; 0 before the first frame.
+        quint64 GetSequence() const;
+        qint64 GetTimestamp() const;
+    private:
+        struct Attachment;
+        std::shared_ptr<Attachment> attachment;
+        quint32 front = 0;
+    };
+
+    // Reference producer: a torus with a wave running along it, published
+    // at a fixed rate.
+    static int Run(QStringList const& arguments);
+};
+
+#endif // STREAM_H
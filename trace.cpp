@@ -0,0 +1,224 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+struct Event
+{
+    const char* category;
+    const char* name;
+    qint64 start;
+    qint64 end;
+};
+
+// Written only by the thread that owns it; head is published with release
+// so a dump on another thread sees complete events. A dump racing a writer
+// that laps the ring may see a few torn events at the oldest end.
+struct Ring
+{
+    static constexpr size_t capacity = 1 << 14;
+    std::unique_ptr<Event[]> events = std::make_unique<Event[]>(capacity);
+    std::atomic<quint64> head{0};
+    std::atomic<bool> owned{true};
+    int id = 0;
+};
+
+// Rings outlive their threads so their events can still be dumped; a new
+// thread takes over a ring whose thread has exited instead of allocating.
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    QElapsedTimer clock;
+    QString path;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+struct RingHandle
+{
+    Ring* ring = nullptr;
+    ~RingHandle()
+    {
+        if (ring)
+        {
+            ring->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+Ring* threadRing()
+{
+    thread_local RingHandle handle;
+    if (handle.ring)
+    {
+        return handle.ring;
+    }
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (std::unique_ptr<Ring>& ring : r.rings)
+    {
+        bool expected = false;
+        if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            handle.ring = ring.get();
+            return handle.ring;
+        }
+    }
+    r.rings.push_back(std::make_unique<Ring>());
+    r.rings.back()->id = static_cast<int>(r.rings.size());
+    handle.ring = r.rings.back().get();
+    return handle.ring;
+}
+
+QString optionPath(QString const& argument)
+{
+    int equals = argument.indexOf('=');
+    return equals < 0 ? QString("lab6-trace.json") : argument.mid(equals + 1);
+}
+}
+
+std::atomic<bool> Trace::enabled{false};
+
+Trace::Scope::Scope(const char* category, const char* name):
+    category(category), name(Trace::IsEnabled() ? name : nullptr), start(this->name ? Trace::now() : 0)
+{
+}
+
+Trace::Scope::~Scope()
+{
+    if (name)
+    {
+        Trace::record(category, name, start, Trace::now());
+    }
+}
+
+Trace::Session::Session(QStringList const& arguments)
+{
+    QString path = qEnvironmentVariable("LAB6_TRACE");
+    for (QString const& argument : arguments)
+    {
+        if (argument == "--trace" || argument.startsWith("--trace="))
+        {
+            path = optionPath(argument);
+            continue;
+        }
+        this->arguments.push_back(argument);
+    }
+    if (!path.isEmpty())
+    {
+        Enable(path);
+    }
+}
+
+Trace::Session::~Session()
+{
+    QString error;
+    if (IsEnabled() && !Dump(QString(), &error))
+    {
+        qWarning().noquote() << error;
+    }
+}
+
+QStringList const& Trace::Session::Arguments() const
+{
+    return arguments;
+}
+
+void Trace::Enable(QString const& path)
+{
+    Registry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.path = path;
+        if (!r.clock.isValid())
+        {
+            r.clock.start();
+        }
+    }
+    enabled.store(true, std::memory_order_release);
+}
+
+QString Trace::GetPath()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.path;
+}
+
+qint64 Trace::now()
+{
+    return registry().clock.nsecsElapsed();
+}
+
+void Trace::record(const char* category, const char* name, qint64 start, qint64 end)
+{
+    Ring* ring = threadRing();
+    quint64 head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head & (Ring::capacity - 1)] = {category, name, start, end};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::Dump(QString const& path, QString* error)
+{
+    Registry& r = registry();
+    QJsonArray events;
+    qint64 pid = QCoreApplication::applicationPid();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (std::unique_ptr<Ring> const& ring : r.rings)
+        {
+            QJsonObject threadName;
+            threadName["name"] = "thread_name";
+            threadName["ph"] = "M";
+            threadName["pid"] = pid;
+            threadName["tid"] = ring->id;
+            threadName["args"] = QJsonObject{{"name", QString("поток %1").arg(ring->id)}};
+            events.append(threadName);
+
+            quint64 head = ring->head.load(std::memory_order_acquire);
+            quint64 first = head > Ring::capacity ? head - Ring::capacity : 0;
+            for (quint64 i = first; i < head; ++i)
+            {
+                Event const& e = ring->events[i & (Ring::capacity - 1)];
+                QJsonObject event;
+                event["name"] = e.name;
+                event["cat"] = e.category;
+                event["ph"] = "X";
+                event["ts"] = e.start / 1e3;
+                event["dur"] = (e.end - e.start) / 1e3;
+                event["pid"] = pid;
+                event["tid"] = ring->id;
+                events.append(event);
+            }
+        }
+    }
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+
+    QFile file(path.isEmpty() ? GetPath() : path);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        if (error)
+        {
+            *error = file.fileName() + ": " + file.errorString();
+        }
+        return false;
+    }
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return true;
+}
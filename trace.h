@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+#include <atomic>
+
+// Opt-in span tracing in the Chrome trace-event format (chrome://tracing,
+// ui.perfetto.dev). Each thread appends to its own fixed ring, so recording
+// never takes a lock; when tracing is off a span costs one atomic load.
+class Trace
+{
+public:
+    class Scope
+    {
+    public:
+        Scope(const char* category, const char* name);
+        ~Scope();
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+    private:
+        const char* category;
+        const char* name;
+        qint64 start;
+    };
+    // Reads LAB6_TRACE=<file> and --trace[=<file>], enables tracing if either
+    // is present and dumps the trace when it goes out of scope.
+    class Session
+    {
+    public:
+        explicit Session(QStringList const& arguments);
+        ~Session();
+        // The arguments without the tracing option, for the mode parsers.
+        QStringList const& Arguments() const;
+    private:
+        QStringList arguments;
+    };
+    static void Enable(QString const& path);
+    static bool IsEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    static QString GetPath();
+    // Writes everything still in the rings; path defaults to the one given
+    // to Enable.
+    static bool Dump(QString const& path = QString(), QString* error = nullptr);
+private:
+    static std::atomic<bool> enabled;
+    static qint64 now();
+    static void record(const char* category, const char* name, qint64 start, qint64 end);
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(category, name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(category, name)
+
+#endif // TRACE_H
@@ -0,0 +1,70 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// Single-writer, single-reader triple buffer. The writer edits a private copy
+// and publishes it into a free slot; the reader picks up the newest published
+// slot. Neither side ever waits for the other, and the reader always sees a
+// complete version.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(TripleBuffer const& other):
+        buffers{other.buffers[0], other.buffers[1], other.buffers[2]}, pending(other.pending),
+        middle(other.middle.load(std::memory_order_acquire)), back(other.back), front(other.front)
+    {
+    }
+    TripleBuffer& operator=(TripleBuffer const& other)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            buffers[i] = other.buffers[i];
+        }
+        pending = other.pending;
+        middle.store(other.middle.load(std::memory_order_acquire), std::memory_order_release);
+        back = other.back;
+        front = other.front;
+        return *this;
+    }
+    // Writer side.
+    T& Edit()
+    {
+        return pending;
+    }
+    T const& Current() const
+    {
+        return pending;
+    }
+    void Publish()
+    {
+        buffers[back] = pending;
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & index;
+    }
+    // Reader side.
+    T const& Read()
+    {
+        if (middle.load(std::memory_order_acquire) & fresh)
+        {
+            front = middle.exchange(front, std::memory_order_acq_rel) & index;
+        }
+        return buffers[front];
+    }
+    T const& Front() const
+    {
+        return buffers[front];
+    }
+private:
+    static constexpr quint8 index = 3;
+    static constexpr quint8 fresh = 4;
+    T buffers[3];
+    T pending;
+    alignas(64) std::atomic<quint8> middle{1};
+    alignas(64) quint8 back = 2;
+    alignas(64) quint8 front = 0;
+};
+
+#endif // TRIPLEBUFFER_H
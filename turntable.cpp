@@ -0,0 +1,181 @@
+#include "turntable.h"
+#include "boundedqueue.h"
+#include "exporter.h"
+#include "parallel.h"
+#include "renderer.h"
+#include "trace.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+struct Frame
+{
+    int index;
+    QImage image;
+};
+
+const QString axisNames[3] = {"x", "y", "z"};
+}
+
+Turntable::Stats Turntable::RenderScene(QString const& name, Mesh const& mesh, SceneFile::View const& view, Options const& options)
+{
+    Renderer prototype = Exporter::CreateRenderer(mesh, view, options.size);
+    prototype.SetProjection(view.projection);
+    double start[3];
+    prototype.GetRotation(start[0], start[1], start[2]);
+
+    int renderThreads = options.renderThreads > 0 ? options.renderThreads
+                                                  : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int writeThreads = std::max(options.writeThreads, 1);
+    // A full queue stops the renderers, so at most this many finished images
+    // wait in memory however slow the disk is.
+    BoundedQueue<Frame> queue(options.queueCapacity > 0 ? options.queueCapacity : 2 * renderThreads);
+    QDir output(options.outputDirectory);
+    std::atomic<int> next{0};
+    std::atomic<int> failures{0};
+    std::atomic<qint64> renderNs{0};
+    std::atomic<qint64> writeNs{0};
+    QElapsedTimer wall;
+    wall.start();
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < writeThreads; ++w)
+    {
+        writers.emplace_back([&]()
+        {
+            while (std::optional<Frame> frame = queue.Pop())
+            {
+                TRACE_SCOPE("turntable", "write frame");
+                QElapsedTimer timer;
+                timer.start();
+                QString path = output.filePath(QString("%1_%2.png").arg(name).arg(frame->index, 4, 10, QChar('0')));
+                if (!frame->image.save(path))
+                {
+                    qWarning().noquote() << path << ": не удалось записать";
+                    ++failures;
+                }
+                writeNs += timer.nsecsElapsed();
+            }
+        });
+    }
+    std::vector<std::thread> renderers;
+    for (int r = 0; r < renderThreads; ++r)
+    {
+        renderers.emplace_back([&]()
+        {
+            // One renderer per core already; its own loops stay on this thread.
+            Parallel::SerialScope serial;
+            Renderer renderer(prototype);
+            for (int i = next++; i < options.frames; i = next++)
+            {
+                TRACE_SCOPE("turntable", "render frame");
+                QElapsedTimer timer;
+                timer.start();
+                double angles[3] = {start[0], start[1], start[2]};
+                angles[options.axis] += 2 * M_PI * i / options.frames;
+                renderer.SetRotation(angles[0], angles[1], angles[2]);
+                QImage image(options.size, QImage::Format_ARGB32_Premultiplied);
+                image.fill(Qt::white);
+                QPainter painter(&image);
+                renderer.Render(painter, options.size);
+                painter.end();
+                renderNs += timer.nsecsElapsed();
+                queue.Push({i, std::move(image)});
+            }
+        });
+    }
+    for (std::thread& renderer : renderers)
+    {
+        renderer.join();
+    }
+    queue.Close();
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+
+    Stats stats;
+    stats.frames = options.frames;
+    stats.failures = failures;
+    stats.seconds = wall.nsecsElapsed() / 1e9;
+    stats.renderMs = options.frames > 0 ? renderNs / 1e6 / options.frames : 0;
+    stats.writeMs = options.frames > 0 ? writeNs / 1e6 / options.frames : 0;
+    return stats;
+}
+
+int Turntable::Run(QStringList const& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Круговой облёт сцены в последовательность PNG");
+    parser.addHelpOption();
+    QCommandLineOption turntableOption("turntable", "Каталог для кадров.", "directory");
+    QCommandLineOption framesOption("frames", "Число кадров на полный оборот.", "count", "36");
+    QCommandLineOption axisOption("axis", "Ось вращения: x, y или z.", "axis", "y");
+    QCommandLineOption sizeOption("size", "Размер кадра WxH.", "size", "1000x800");
+    QCommandLineOption threadsOption("threads", "Потоков отрисовки, 0 — по числу ядер.", "count", "0");
+    QCommandLineOption writersOption("writers", "Потоков кодирования и записи PNG.", "count", "2");
+    QCommandLineOption queueOption("queue", "Кадров в очереди на запись, 0 — вдвое больше потоков отрисовки.", "count", "0");
+    parser.addOption(turntableOption);
+    parser.addOption(framesOption);
+    parser.addOption(axisOption);
+    parser.addOption(sizeOption);
+    parser.addOption(threadsOption);
+    parser.addOption(writersOption);
+    parser.addOption(queueOption);
+    parser.addPositionalArgument("scenes", "Файлы сцен.");
+    parser.process(arguments);
+
+    Options options;
+    options.outputDirectory = parser.value(turntableOption);
+    options.frames = parser.value(framesOption).toInt();
+    options.axis = static_cast<int>(std::find(axisNames, axisNames + 3, parser.value(axisOption).toLower()) - axisNames);
+    options.renderThreads = parser.value(threadsOption).toInt();
+    options.writeThreads = parser.value(writersOption).toInt();
+    options.queueCapacity = parser.value(queueOption).toInt();
+    QStringList size = parser.value(sizeOption).split('x');
+    if (size.size() == 2 && size[0].toInt() > 0 && size[1].toInt() > 0)
+    {
+        options.size = QSize(size[0].toInt(), size[1].toInt());
+    }
+    if (options.frames <= 0 || options.axis > 2 || parser.positionalArguments().isEmpty()
+        || !QDir().mkpath(options.outputDirectory))
+    {
+        qWarning().noquote() << "Использование: Lab6 --turntable <каталог> [--frames N] [--axis x|y|z] [--size WxH]"
+                                " [--threads N] [--writers N] [--queue N] <сцены...>";
+        return 1;
+    }
+
+    int failures = 0;
+    for (QString const& path : parser.positionalArguments())
+    {
+        Mesh mesh;
+        SceneFile::View view;
+        QString error;
+        if (!SceneFile::Load(path, mesh, view, &error))
+        {
+            qWarning().noquote() << path << ":" << error;
+            ++failures;
+            continue;
+        }
+        Stats stats = RenderScene(QFileInfo(path).completeBaseName(), mesh, view, options);
+        failures += stats.failures > 0;
+        qInfo().noquote() << QString("%1: %2 кадров за %3 с, %4 кадр/с (отрисовка %5 мс, запись %6 мс на кадр в потоке)")
+                             .arg(path)
+                             .arg(stats.frames)
+                             .arg(stats.seconds, 0, 'f', 2)
+                             .arg(stats.frames / std::max(stats.seconds, 1e-9), 0, 'f', 1)
+                             .arg(stats.renderMs, 0, 'f', 1)
+                             .arg(stats.writeMs, 0, 'f', 1);
+    }
+    return failures == 0 ? 0 : 1;
+}
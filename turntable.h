@@ -0,0 +1,39 @@
+#ifndef TURNTABLE_H
+#define TURNTABLE_H
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include "mesh.h"
+#include "scenefile.h"
+
+// Renders a scene from evenly spaced angles around one axis into numbered
+// PNG files. Frames are rendered by a pool of threads, each with its own
+// renderer, and handed to PNG writers through a bounded queue.
+class Turntable
+{
+public:
+    struct Options
+    {
+        QString outputDirectory;
+        int frames = 36;
+        // 0, 1 or 2: which view angle sweeps a full turn.
+        int axis = 1;
+        QSize size = QSize(1000, 800);
+        int renderThreads = 0;
+        int writeThreads = 2;
+        int queueCapacity = 0;
+    };
+    struct Stats
+    {
+        int frames = 0;
+        int failures = 0;
+        double seconds = 0;
+        double renderMs = 0;
+        double writeMs = 0;
+    };
+    static Stats RenderScene(QString const& name, Mesh const& mesh, SceneFile::View const& view, Options const& options);
+    static int Run(QStringList const& arguments);
+};
+
+#endif // TURNTABLE_H